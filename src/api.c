@@ -41,7 +41,7 @@ int init()
     char *gnubg_weights = "./data/gnubg.weights";
     char *gnubg_weights_binary = "./data/gnubg.wd";
     int fNoBearoff = FALSE;
-    EvalInitialise(gnubg_weights, gnubg_weights_binary, fNoBearoff, NULL);
+    EvalInitialise(gnubg_weights, gnubg_weights_binary, fNoBearoff, 0, NULL);
 
     MT_InitThreads();
 
@@ -82,6 +82,9 @@ void appendCubeDecisionData(StringBuffer *jb, const char *action, const PlayerAc
     sbAppend(jb, "}");
 }
 
+// Play one-sided bearoffs from the table of best plays, see bearoff_plays()
+static int fBearoffPlay = FALSE;
+
 const char *hint(const char *xgid, int nPlies)
 {
     StringBuffer jb;
@@ -90,7 +93,7 @@ const char *hint(const char *xgid, int nPlies)
 
     PlayerActionInfo pai;
 
-    int res = findBestAction(&pai, xgid, nPlies);
+    int res = findBestAction(&pai, xgid, nPlies, fBearoffPlay);
 
     if (res < 0) {
         sbAppendf(&jb, "\"error\": %d}", res);
@@ -157,3 +160,121 @@ const char *hint(const char *xgid, int nPlies)
 
     return sbFinalize(&jb);
 }
+
+int quantize(int nBits)
+{
+    return EvalSetQuantization(nBits);
+}
+
+int bearoff_plays(int fUse)
+{
+    if (EvalBearoffPlays(fUse) < 0)
+        return -1;
+
+    fBearoffPlay = fUse;
+
+    return 0;
+}
+
+static const char *aszClass[N_CLASSES] = {
+    "over", "hypergammon1", "hypergammon2", "hypergammon3", "bearoff2", "bearoff_ts",
+    "bearoff1", "bearoff_os", "race", "crashed", "contact"};
+
+const char *quantization_error(int nBits, int nPositions)
+{
+    StringBuffer jb;
+    sbInit(&jb);
+    sbAppend(&jb, "{");
+
+    quanterror aqe[N_CLASSES];
+
+    if (nPositions <= 0 || EvalQuantizationError(nBits, nPositions, aqe) < 0) {
+        sbAppendf(&jb, "\"error\": %d}", -1);
+        return sbFinalize(&jb);
+    }
+
+    sbAppendf(&jb, "\"bits\": %d, \"classes\": {", nBits);
+    int first = 1;
+    for (int i = 0; i < N_CLASSES; i++) {
+        if (!aqe[i].cPositions) continue;
+        if (!first) sbAppend(&jb, ",");
+        first = 0;
+        sbAppendf(&jb, "\"%s\": {\"positions\": %u, \"max\": %.6f, \"mean\": %.6f}",
+                  aszClass[i], aqe[i].cPositions, aqe[i].rMax, aqe[i].rMean);
+    }
+    sbAppend(&jb, "}}");
+
+    return sbFinalize(&jb);
+}
+
+int cache_size(int nSize, int fCompact)
+{
+    if (nSize < 0 || nSize > CACHE_SIZE_GUIMAX - 16)
+        return -1;
+
+    return SetEvalCacheSize((unsigned int)nSize, fCompact ? CACHE_LAYOUT_COMPACT : CACHE_LAYOUT_FULL);
+}
+
+static void appendCounts(StringBuffer *jb, const unsigned long long an[N_CACHE_COUNTS])
+{
+    sbAppendf(jb, "\"lookups\": %llu, \"hits\": %llu, \"collisions\": %llu, \"evictions\": %llu",
+              an[CACHE_COUNT_LOOKUP], an[CACHE_COUNT_HIT], an[CACHE_COUNT_COLLIDE], an[CACHE_COUNT_EVICT]);
+}
+
+static void appendCache(StringBuffer *jb, const char *name, const evalCache *pc,
+                        unsigned long long aac[N_CLASSES][CACHE_COUNT_PLIES][N_CACHE_COUNTS])
+{
+    unsigned long long anTotal[N_CACHE_COUNTS] = {0};
+    unsigned long long aanClass[N_CLASSES][N_CACHE_COUNTS] = {{0}};
+
+    for (int i = 0; i < N_CLASSES; i++)
+        for (int j = 0; j < CACHE_COUNT_PLIES; j++)
+            for (int k = 0; k < N_CACHE_COUNTS; k++) {
+                aanClass[i][k] += aac[i][j][k];
+                anTotal[k] += aac[i][j][k];
+            }
+
+    sbAppendf(jb, "\"%s\": {\"entries\": %u, \"layout\": \"%s\", ", name, pc->size,
+              pc->layout == CACHE_LAYOUT_COMPACT ? "compact" : "full");
+    appendCounts(jb, anTotal);
+    sbAppend(jb, ", \"classes\": {");
+    int first = 1;
+    for (int i = 0; i < N_CLASSES; i++) {
+        if (!aanClass[i][CACHE_COUNT_LOOKUP] && !aanClass[i][CACHE_COUNT_COLLIDE] && !aanClass[i][CACHE_COUNT_EVICT])
+            continue;
+        if (!first) sbAppend(jb, ",");
+        first = 0;
+        sbAppendf(jb, "\"%s\": {", aszClass[i]);
+        appendCounts(jb, aanClass[i]);
+        sbAppend(jb, ", \"plies\": {");
+        int firstPly = 1;
+        for (int j = 0; j < CACHE_COUNT_PLIES; j++) {
+            if (!aac[i][j][CACHE_COUNT_LOOKUP] && !aac[i][j][CACHE_COUNT_COLLIDE] && !aac[i][j][CACHE_COUNT_EVICT])
+                continue;
+            if (!firstPly) sbAppend(jb, ",");
+            firstPly = 0;
+            sbAppendf(jb, "\"%d\": {", j);
+            appendCounts(jb, aac[i][j]);
+            sbAppend(jb, "}");
+        }
+        sbAppend(jb, "}}");
+    }
+    sbAppend(jb, "}}");
+}
+
+const char *cache_stats(int fReset)
+{
+    cachecounts cc;
+    StringBuffer jb;
+    sbInit(&jb);
+
+    EvalCacheCounts(&cc, fReset);
+
+    sbAppend(&jb, "{");
+    appendCache(&jb, "eval", &cEval, cc.aac[0]);
+    sbAppend(&jb, ",");
+    appendCache(&jb, "prune", &cpEval, cc.aac[1]);
+    sbAppend(&jb, "}");
+
+    return sbFinalize(&jb);
+}
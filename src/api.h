@@ -28,4 +28,48 @@ int shutdown();
  */
 const char *hint(const char *xgid, int nPlies);
 
+/**
+ * Evaluate the neural nets with weights quantized to 16 or 8 bits,
+ * or with the original float weights if nBits is 0.
+ *
+ * Returns 0 on success.
+ */
+int quantize(int nBits);
+
+/**
+ * Play the chequers of one-sided bearoff positions at 0 plies from a
+ * table of best plays built from the bearoff database, rather than by
+ * evaluating each move (off by default).  The table takes about 2 MB.
+ *
+ * Returns 0 on success.
+ */
+int bearoff_plays(int fUse);
+
+/**
+ * Measure the error of the nets quantized to nBits over a fixed corpus
+ * of nPositions positions from random games.
+ *
+ * Returns a JSON string with the max and mean equity error per class.
+ */
+const char *quantization_error(int nBits, int nPositions);
+
+/**
+ * Give the evaluation cache the memory of 2^(16 + nSize) full entries,
+ * about 7.5 MB for nSize 1 and twice as much for each step up to 7 (the
+ * default is 3, 0 for no cache), in the compact layout if fCompact,
+ * which fits four times as many positions in it.  The cache is emptied.
+ *
+ * Returns the number of entries, or -1 on failure.
+ */
+int cache_size(int nSize, int fCompact);
+
+/**
+ * Counters of the evaluation and pruning caches since the start or the
+ * last reset: lookups, hits, collisions and evictions, by class of
+ * position and plies of the evaluation.  Zeroes them after if fReset.
+ *
+ * Returns a JSON string.
+ */
+const char *cache_stats(int fReset);
+
 #endif // API_H
@@ -29,6 +29,7 @@
 #include "bearoffgammon.h"
 #include "positionid.h"
 
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -1225,3 +1226,123 @@ isBearoff(const bearoffcontext * pbc, const TanBoard anBoard)
     else
         return FALSE;
 }
+
+/*
+ * Best plays of a one-sided database, for each position and roll the
+ * position left by the play that minimises the expected number of
+ * rolls to bear off (the policy the exact databases are built with).
+ */
+
+typedef struct {
+    unsigned int nPoints, nChequers;
+    const unsigned int *anMean; /* expected rolls of each position, times 65535 */
+    unsigned int iBest;
+    unsigned int nBest;
+} bearoffplay;
+
+/* Play the c dice of anDice[] in all the ways from points below iStart,
+ * which is the point of the previous chequer moved for doubles (as in
+ * GenerateMovesSub(), doubles need not be played in every order) */
+static void
+BestBearoffPlay(bearoffplay * pbp, unsigned int anBoard[6], const unsigned int anDice[], unsigned int c,
+                unsigned int iStart)
+{
+    unsigned int i, nMax;
+
+    for (nMax = pbp->nPoints; nMax > 0 && !anBoard[nMax - 1]; nMax--);
+
+    if (!c || !nMax) {
+        unsigned int iPos = PositionBearoff(anBoard, pbp->nPoints, pbp->nChequers);
+
+        if (pbp->anMean[iPos] < pbp->nBest || (pbp->anMean[iPos] == pbp->nBest && iPos < pbp->iBest)) {
+            pbp->nBest = pbp->anMean[iPos];
+            pbp->iBest = iPos;
+        }
+        return;
+    }
+
+    for (i = 0; i < nMax && i <= iStart; i++) {
+        if (!anBoard[i] || (i + 1 < anDice[0] && i + 1 < nMax))
+            /* nothing to move, or can't bear off with chequers behind */
+            continue;
+
+        anBoard[i]--;
+        if (i >= anDice[0])
+            anBoard[i - anDice[0]]++;
+
+        BestBearoffPlay(pbp, anBoard, anDice + 1, c - 1, c > 1 && anDice[1] == anDice[0] ? i : 5);
+
+        if (i >= anDice[0])
+            anBoard[i - anDice[0]]--;
+        anBoard[i]++;
+    }
+}
+
+extern unsigned short int *
+BearoffPlays(const bearoffcontext * pbc)
+{
+    bearoffplay bp;
+    unsigned int *anMean;
+    unsigned short int *aus;
+    unsigned int nPositions, iPos, i, n0, n1;
+
+    g_return_val_if_fail(pbc, NULL);
+    g_return_val_if_fail(pbc->bt == BEAROFF_ONESIDED && pbc->nPoints <= 6, NULL);
+
+    nPositions = Combination(pbc->nPoints + pbc->nChequers, pbc->nPoints);
+    g_return_val_if_fail(nPositions <= 0x10000, NULL);
+
+    anMean = malloc(nPositions * sizeof(anMean[0]));
+    aus = malloc(nPositions * 21 * sizeof(aus[0]));
+    if (!anMean || !aus) {
+        free(anMean);
+        free(aus);
+        return NULL;
+    }
+
+    for (iPos = 0; iPos < nPositions; iPos++) {
+        unsigned short int ausProb[32];
+
+        if (BearoffDist(pbc, iPos, NULL, NULL, NULL, ausProb, NULL)) {
+            free(anMean);
+            free(aus);
+            return NULL;
+        }
+
+        for (anMean[iPos] = 0, i = 1; i < 32; i++)
+            anMean[iPos] += i * ausProb[i];
+    }
+
+    bp.nPoints = pbc->nPoints;
+    bp.nChequers = pbc->nChequers;
+    bp.anMean = anMean;
+
+    for (iPos = 0; iPos < nPositions; iPos++) {
+        unsigned int anBoard[6] = { 0 };
+
+        PositionFromBearoff(anBoard, iPos, pbc->nPoints, pbc->nChequers);
+
+        for (n0 = 1; n0 <= 6; n0++)
+            for (n1 = 1; n1 <= n0; n1++) {
+                unsigned int anDice[4] = { n0, n1, n0, n0 };
+
+                bp.nBest = UINT_MAX;
+                bp.iBest = 0;
+
+                if (n0 == n1)
+                    BestBearoffPlay(&bp, anBoard, anDice, 4, 5);
+                else {
+                    BestBearoffPlay(&bp, anBoard, anDice, 2, 5);
+                    anDice[0] = n1;
+                    anDice[1] = n0;
+                    BestBearoffPlay(&bp, anBoard, anDice, 2, 5);
+                }
+
+                aus[iPos * 21 + BEAROFF_ROLL(n0, n1)] = (unsigned short int) bp.iBest;
+            }
+    }
+
+    free(anMean);
+
+    return aus;
+}
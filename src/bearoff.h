@@ -83,6 +83,13 @@ extern int
 extern float
  fnd(const float x, const float mu, const float sigma);
 
+/* Index of the roll n0 >= n1 in the table of BearoffPlays() */
+#define BEAROFF_ROLL(n0, n1) ((n0) * ((n0) - 1) / 2 + (n1) - 1)
+
+/* Table of 21 entries per position of a one-sided database, the
+ * position left by the best play of each roll; free() it */
+extern unsigned short int *BearoffPlays(const bearoffcontext * pbc);
+
 extern int
  BearoffHyper(const bearoffcontext * pbc, const unsigned int iPos, float arOutput[], float arEquity[]);
 
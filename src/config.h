@@ -7,9 +7,15 @@
 /* Define to 1 if you have the <unistd.h> header file. */
 #define HAVE_UNISTD_H 1
 
+/* Define to 1 if you have the <sys/mman.h> header file. */
+#define HAVE_SYS_MMAN_H 1
+
 /* define if your compiler has __attribute__ */
 #define HAVE___ATTRIBUTE__ 1
 
+/* Define to 1 if the compiler has __builtin_clz */
+#define HAVE___BUILTIN_CLZ 1
+
 /* Name of package */
 #define PACKAGE "gnubg"
 
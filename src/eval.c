@@ -33,6 +33,12 @@
 #include <locale.h>
 #include <stdlib.h>
 #include <string.h>
+#if HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 typedef void (*classstatusfunc)(char *szOutput);
 typedef int (*cfunc)(const void *, const void *);
@@ -190,10 +196,17 @@ enum {
 
 #define NUM_INPUTS ((25 * MINPPERPOINT + MORE_INPUTS) * 2)
 #define NUM_RACE_INPUTS (HALF_RACE_INPUTS * 2)
+/* Non-zero race inputs: two per point at most, the men off and nCross */
+#define MAX_RACE_ACTIVE ((23 * 2 + 2) * 2)
 #define NUM_PRUNING_INPUTS (25 * MINPPERPOINT * 2)
 
+#if defined(USE_MULTITHREAD)
+#define CacheAdd CacheAddWithLocking
+#define CacheLookup CacheLookupWithLocking
+#else
 #define CacheAdd CacheAddNoLocking
 #define CacheLookup CacheLookupNoLocking
+#endif
 
 static int EvaluatePositionCache(NNState *nnStates, const TanBoard anBoard, float arOutput[],
                                  cubeinfo *const pci, const evalcontext *pecx, int nPlies, positionclass pc);
@@ -211,10 +224,16 @@ neuralnet nnContact, nnRace, nnCrashed;
 
 neuralnet nnpContact, nnpRace, nnpCrashed;
 
+/* An NN_BINARY_MAPPED weights file the nets point into */
+static void *pWeightsMap = NULL;
+static size_t cbWeightsMap;
+static int fWeightsMmap;        /* from mmap(), else read in a buffer */
+
 bearoffcontext *pbcOS = NULL;
 bearoffcontext *pbcTS = NULL;
 bearoffcontext *pbc1 = NULL;
 bearoffcontext *pbc2 = NULL;
+static unsigned short int *ausBearoffPlay;      /* see EvalBearoffPlays() */
 bearoffcontext *apbcHyper[3] = {NULL, NULL, NULL};
 
 evalCache cEval;
@@ -222,13 +241,45 @@ evalCache cpEval;
 unsigned int cCache;
 int fInterrupt = FALSE;
 
+/* The counters of this thread for an entry of cEval or cpEval */
+static inline unsigned long long *
+CacheCounts(const evalCache *pc, positionclass pcl, int nEvalContext)
+{
+    int const nPlies = CachePlies(nEvalContext);
+
+    return MT_GetTLD()->pcc->aac[pc == &cpEval][pcl][nPlies < CACHE_COUNT_PLIES ? nPlies : CACHE_COUNT_PLIES - 1];
+}
+
+static inline void
+CountLookup(const evalCache *pc, positionclass pcl, int nEvalContext, int fHit)
+{
+    unsigned long long *an = CacheCounts(pc, pcl, nEvalContext);
+
+    an[CACHE_COUNT_LOOKUP]++;
+    if (fHit)
+        an[CACHE_COUNT_HIT]++;
+}
+
+static inline void
+CountAdd(const evalCache *pc, positionclass pcl, int nEvalContext, unsigned int nAdd)
+{
+    if (nAdd) {
+        unsigned long long *an = CacheCounts(pc, pcl, nEvalContext);
+
+        if (nAdd & CACHE_ADD_COLLIDE)
+            an[CACHE_COUNT_COLLIDE]++;
+        if (nAdd & CACHE_ADD_EVICT)
+            an[CACHE_COUNT_EVICT]++;
+    }
+}
+
 /* variation of backgammon used by gnubg */
 bgvariation bgvDefault = VARIATION_STANDARD;
 
 /* the number of chequers for the variations */
 int anChequers[NUM_VARIATIONS] = {15, 15, 1, 2, 3};
 
-evalcontext ecBasic = {FALSE, 0, FALSE, TRUE, 0.0};
+evalcontext ecBasic = {FALSE, 0, FALSE, TRUE, FALSE, 0.0};
 
 /* defaults for the filters  - 0 ply uses no filters */
 
@@ -239,6 +290,9 @@ movefilter defaultFilters[MAX_FILTER_PLIES][MAX_FILTER_PLIES] = MOVEFILTER_NORMA
 /* Random context, for generating non-deterministic noisy evaluations. */
 static randctx rc;
 
+/* Bits of the quantized weights of the nets, 0 for float */
+static int nNetQuant = 0;
+
 /* parameters for EvalEfficiency */
 
 static float rTSCubeX = 0.6f; /* for match play only */
@@ -250,6 +304,13 @@ float rRaceMin[2] = {0.6f, 0.6f};
 float rCrashedX[2] = {0.68f, 0.76f};
 float rContactX[2] = {0.68f, 0.76f};
 
+#ifdef HAVE___BUILTIN_CLZ
+static inline int
+msb32(int n)
+{
+    return 31 - __builtin_clz((unsigned int)n);
+}
+#else
 static inline int
 msb32(int n)
 /* from rosettacode.org */
@@ -265,6 +326,7 @@ msb32(int n)
 #undef step
     return b;
 }
+#endif
 
 static void
 ComputeTable0(void)
@@ -283,18 +345,35 @@ ComputeTable0(void)
     }
 }
 
-static int
-Escapes(const unsigned int anBoard[25], int n)
+/* The points of anBoard[] with two or more chequers, as a bit set */
+static inline unsigned int
+MadePoints(const unsigned int anBoard[25])
 {
+    unsigned int i, f = 0;
+
+    for (i = 0; i < 24; i++)
+        f |= (unsigned int)anPoint[anBoard[i]] << i;
+
+    return f;
+}
 
-    int i, af = 0, m;
+/* The 12 points in front of point n (fewer if n < 12) of the made
+ * points fMade, as an index into anEscapes[] and anEscapes1[] */
+static inline int
+EscapeMask(unsigned int fMade, int n)
+{
+    int m = (n < 12) ? n : 12;
 
-    m = (n < 12) ? n : 12;
+    if (m <= 0)
+        return 0;
 
-    for (i = 0; i < m; i++)
-        af |= (anPoint[anBoard[24 + i - n]] << i);
+    return (int)((fMade >> (24 - n)) & ((1u << m) - 1));
+}
 
-    return anEscapes[af];
+static int
+Escapes(unsigned int fMade, int n)
+{
+    return anEscapes[EscapeMask(fMade, n)];
 }
 
 static void
@@ -325,17 +404,9 @@ ComputeTable1(void)
 }
 
 static int
-Escapes1(const unsigned int anBoard[25], int n)
+Escapes1(unsigned int fMade, int n)
 {
-
-    int i, af = 0, m;
-
-    m = (n < 12) ? n : 12;
-
-    for (i = 0; i < m; i++)
-        af |= (anPoint[anBoard[24 + i - n]] << i);
-
-    return anEscapes1[af];
+    return anEscapes1[EscapeMask(fMade, n)];
 }
 
 static void
@@ -345,6 +416,98 @@ ComputeTable(void)
     ComputeTable1();
 }
 
+static void
+UnmapWeights(void)
+{
+    if (!pWeightsMap)
+        return;
+
+#if HAVE_SYS_MMAN_H
+    if (fWeightsMmap)
+        munmap(pWeightsMap, cbWeightsMap);
+    else
+#endif
+        sse_free(pWeightsMap);
+
+    pWeightsMap = NULL;
+}
+
+/* Map the NN_BINARY_MAPPED file szWeightsBinary and point the nets into
+ * it; where mmap() is not available the file is read in a buffer */
+static int
+MapWeights(const char *szWeightsBinary)
+{
+    neuralnet *apnn[] = {&nnContact, &nnRace, &nnCrashed, &nnpContact, &nnpCrashed, &nnpRace};
+    const void *p;
+    size_t cb;
+    unsigned int i;
+
+    /* no net may be left pointing into a previous file */
+    for (i = 0; i < sizeof(apnn) / sizeof(apnn[0]); i++)
+        if (apnn[i]->fMapped)
+            NeuralNetDestroy(apnn[i]);
+    UnmapWeights();
+
+#if HAVE_SYS_MMAN_H
+    {
+        struct stat st;
+        int fd;
+
+        if ((fd = open(szWeightsBinary, O_RDONLY)) >= 0) {
+            if (!fstat(fd, &st) && st.st_size > 0) {
+                /* read only, so the pages are shared with any other
+                 * process mapping the same file */
+                cbWeightsMap = (size_t)st.st_size;
+                if ((pWeightsMap = mmap(NULL, cbWeightsMap, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+                    pWeightsMap = NULL;
+                fWeightsMmap = TRUE;
+            }
+            close(fd);
+        }
+    }
+#endif
+
+    if (!pWeightsMap) {
+        FILE *pf;
+        long cbFile;
+
+        if ((pf = g_fopen(szWeightsBinary, "rb")) == NULL)
+            return -1;
+
+        if (fseek(pf, 0, SEEK_END) || (cbFile = ftell(pf)) <= 0 || fseek(pf, 0, SEEK_SET) ||
+            (pWeightsMap = sse_malloc(cbWeightsMap = (size_t)cbFile)) == NULL ||
+            fread(pWeightsMap, 1, cbWeightsMap, pf) < cbWeightsMap) {
+            fclose(pf);
+            UnmapWeights();
+            return -1;
+        }
+
+        fclose(pf);
+        fWeightsMmap = FALSE;
+    }
+
+    /* the header of the file takes a whole section */
+    if (cbWeightsMap < NN_MAP_ALIGN) {
+        UnmapWeights();
+        errno = EINVAL;
+        return -1;
+    }
+
+    p = (const char *)pWeightsMap + NN_MAP_ALIGN;
+    cb = cbWeightsMap - NN_MAP_ALIGN;
+
+    /* same order as EvalSaveBinary() writes them */
+    for (i = 0; i < sizeof(apnn) / sizeof(apnn[0]); i++)
+        if (NeuralNetMap(apnn[i], &p, &cb)) {
+            while (i--)
+                NeuralNetDestroy(apnn[i]);
+            UnmapWeights();
+            return -1;
+        }
+
+    return 0;
+}
+
 static void
 DestroyWeights(void)
 {
@@ -355,6 +518,8 @@ DestroyWeights(void)
     NeuralNetDestroy(&nnpContact);
     NeuralNetDestroy(&nnpCrashed);
     NeuralNetDestroy(&nnpRace);
+
+    UnmapWeights();
 }
 
 extern int
@@ -362,6 +527,7 @@ EvalShutdown(void)
 {
     /* close bearoff databases */
 
+    EvalBearoffPlays(FALSE);
     BearoffClose(pbc1);
     BearoffClose(pbc2);
     BearoffClose(pbcOS);
@@ -382,7 +548,7 @@ EvalShutdown(void)
 }
 
 static int
-binary_weights_failed(char *filename, FILE *weights)
+binary_weights_failed(char *filename, FILE *weights, int *pnFormat)
 {
     float r;
 
@@ -396,7 +562,13 @@ binary_weights_failed(char *filename, FILE *weights)
         g_print("\n");
         return -2;
     }
-    if (r != WEIGHTS_MAGIC_BINARY) {
+    if (r == WEIGHTS_MAGIC_BINARY)
+        *pnFormat = NN_BINARY_DENSE;
+    else if (r == WEIGHTS_MAGIC_BINARY_LAYOUT)
+        *pnFormat = NN_BINARY_LAYOUT;
+    else if (r == WEIGHTS_MAGIC_BINARY_MAPPED)
+        *pnFormat = NN_BINARY_MAPPED;
+    else {
         g_print(_("%s is not a weights file"), filename);
         g_print("\n");
         return -3;
@@ -442,7 +614,7 @@ weights_failed(char *filename, FILE *weights)
 }
 
 extern void
-EvalInitialise(char *szWeights, char *szWeightsBinary, int fNoBearoff, void (*pfProgress)(unsigned int))
+EvalInitialise(char *szWeights, char *szWeightsBinary, int fNoBearoff, int nQuantBits, void (*pfProgress)(unsigned int))
 {
     FILE *pfWeights = NULL;
     int i, fReadWeights = FALSE;
@@ -450,12 +622,12 @@ EvalInitialise(char *szWeights, char *szWeightsBinary, int fNoBearoff, void (*pf
 
     if (!fInitialised) {
         cCache = 0x1 << CACHE_SIZE_DEFAULT;
-        if (CacheCreate(&cEval, cCache)) {
+        if (CacheCreate(&cEval, cCache, CACHE_LAYOUT_FULL)) {
             PrintError(_("Evaluation cache allocation failed"));
             return;
         }
 
-        if (CacheCreate(&cpEval, 0x1 << 16)) {
+        if (CacheCreate(&cpEval, 0x1 << 16, CACHE_LAYOUT_FULL)) {
             PrintError(_("Evaluation cache allocation failed"));
             return;
         }
@@ -520,15 +692,20 @@ EvalInitialise(char *szWeights, char *szWeightsBinary, int fNoBearoff, void (*pf
     }
 
     if (szWeightsBinary) {
+        int nFormat;
+
         pfWeights = g_fopen(szWeightsBinary, "rb");
-        if (!binary_weights_failed(szWeightsBinary, pfWeights)) {
-            if (!fReadWeights && !(fReadWeights =
-                                       !NeuralNetLoadBinary(&nnContact, pfWeights) &&
-                                       !NeuralNetLoadBinary(&nnRace, pfWeights) &&
-                                       !NeuralNetLoadBinary(&nnCrashed, pfWeights) &&
-                                       !NeuralNetLoadBinary(&nnpContact, pfWeights) &&
-                                       !NeuralNetLoadBinary(&nnpCrashed, pfWeights) &&
-                                       !NeuralNetLoadBinary(&nnpRace, pfWeights))) {
+        if (!binary_weights_failed(szWeightsBinary, pfWeights, &nFormat)) {
+            if (nFormat == NN_BINARY_MAPPED) {
+                if (!(fReadWeights = !MapWeights(szWeightsBinary)))
+                    perror(szWeightsBinary);
+            } else if (!fReadWeights && !(fReadWeights =
+                                       !NeuralNetLoadBinary(&nnContact, pfWeights, nFormat) &&
+                                       !NeuralNetLoadBinary(&nnRace, pfWeights, nFormat) &&
+                                       !NeuralNetLoadBinary(&nnCrashed, pfWeights, nFormat) &&
+                                       !NeuralNetLoadBinary(&nnpContact, pfWeights, nFormat) &&
+                                       !NeuralNetLoadBinary(&nnpCrashed, pfWeights, nFormat) &&
+                                       !NeuralNetLoadBinary(&nnpRace, pfWeights, nFormat))) {
                 perror(szWeightsBinary);
             }
         }
@@ -569,171 +746,214 @@ EvalInitialise(char *szWeights, char *szWeightsBinary, int fNoBearoff, void (*pf
         g_printerr(_("GNU Backgammon couldn't find a weights file."));
         exit(EXIT_FAILURE);
     }
+
+    /* the nets fed by baseInputs() evaluate the board through a table,
+     * unless it came with the mapped weights */
+    if (NeuralNetBoardTable(&nnContact, baseInputs) || NeuralNetBoardTable(&nnCrashed, baseInputs) ||
+        NeuralNetBoardTable(&nnpContact, baseInputs) || NeuralNetBoardTable(&nnpCrashed, baseInputs) ||
+        NeuralNetBoardTable(&nnpRace, baseInputs))
+        PrintError(_("Neural net table allocation failed"));
+
+    if (nQuantBits && EvalSetQuantization(nQuantBits))
+        PrintError(_("Neural net quantization failed"));
 }
 
-/* Calculates inputs for any contact position, for one player only. */
+extern int
+EvalSaveBinary(const char *szWeightsBinary, int nFormat)
+{
+    /* NN_BINARY_MAPPED pads the header to a whole section */
+    float arHeader[NN_MAP_ALIGN / sizeof(float)] = {WEIGHTS_MAGIC_BINARY, WEIGHTS_VERSION_BINARY};
+    size_t const cHeader = nFormat == NN_BINARY_MAPPED ? NN_MAP_ALIGN / sizeof(float) : 2;
+    FILE *pf;
+    int f;
+
+    if (nFormat == NN_BINARY_LAYOUT)
+        arHeader[0] = WEIGHTS_MAGIC_BINARY_LAYOUT;
+    else if (nFormat == NN_BINARY_MAPPED)
+        arHeader[0] = WEIGHTS_MAGIC_BINARY_MAPPED;
 
-static void
-CalculateHalfInputs(const unsigned int anBoard[25], const unsigned int anBoardOpp[25], float afInput[])
+    if ((pf = g_fopen(szWeightsBinary, "wb")) == NULL)
+        return -1;
+
+    /* same order as EvalInitialise() reads them */
+    f = fwrite(arHeader, sizeof(arHeader[0]), cHeader, pf) < cHeader ||
+        NeuralNetSaveBinary(&nnContact, pf, nFormat) ||
+        NeuralNetSaveBinary(&nnRace, pf, nFormat) ||
+        NeuralNetSaveBinary(&nnCrashed, pf, nFormat) ||
+        NeuralNetSaveBinary(&nnpContact, pf, nFormat) ||
+        NeuralNetSaveBinary(&nnpCrashed, pf, nFormat) || NeuralNetSaveBinary(&nnpRace, pf, nFormat);
+
+    if (fclose(pf))
+        f = TRUE;
+
+    return f ? -1 : 0;
+}
+
+extern int
+EvalSetQuantization(int nBits)
 {
-    int i, j, k, l, nOppBack, n, aHit[39], nBoard;
+    neuralnet *apnn[] = {&nnContact, &nnRace, &nnCrashed, &nnpContact, &nnpCrashed, &nnpRace};
+    unsigned int i;
 
-    /* aanCombination[n] -
-     * How many ways to hit from a distance of n pips.
-     * Each number is an index into aIntermediate below.
-     */
-    static const int aanCombination[24][5] = {
-        {0, -1, -1, -1, -1},  /*  1 */
-        {1, 2, -1, -1, -1},   /*  2 */
-        {3, 4, 5, -1, -1},    /*  3 */
-        {6, 7, 8, 9, -1},     /*  4 */
-        {10, 11, 12, -1, -1}, /*  5 */
-        {13, 14, 15, 16, 17}, /*  6 */
-        {18, 19, 20, -1, -1}, /*  7 */
-        {21, 22, 23, 24, -1}, /*  8 */
-        {25, 26, 27, -1, -1}, /*  9 */
-        {28, 29, -1, -1, -1}, /* 10 */
-        {30, -1, -1, -1, -1}, /* 11 */
-        {31, 32, 33, -1, -1}, /* 12 */
-        {-1, -1, -1, -1, -1}, /* 13 */
-        {-1, -1, -1, -1, -1}, /* 14 */
-        {34, -1, -1, -1, -1}, /* 15 */
-        {35, -1, -1, -1, -1}, /* 16 */
-        {-1, -1, -1, -1, -1}, /* 17 */
-        {36, -1, -1, -1, -1}, /* 18 */
-        {-1, -1, -1, -1, -1}, /* 19 */
-        {37, -1, -1, -1, -1}, /* 20 */
-        {-1, -1, -1, -1, -1}, /* 21 */
-        {-1, -1, -1, -1, -1}, /* 22 */
-        {-1, -1, -1, -1, -1}, /* 23 */
-        {38, -1, -1, -1, -1}  /* 24 */
-    };
+    if (nBits == nNetQuant)
+        return 0;
 
-    /* One way to hit */
-    typedef struct {
-        /* if true, all intermediate points (if any) are required;
-         * if false, one of two intermediate points are required.
-         * Set to true for a direct hit, but that can be checked with
-         * nFaces == 1,
-         */
-        int fAll;
+    for (i = 0; i < sizeof(apnn) / sizeof(apnn[0]); i++)
+        if (NeuralNetQuantize(apnn[i], nBits)) {
+            /* leave all the nets in the previous mode */
+            while (i--)
+                NeuralNetQuantize(apnn[i], nNetQuant);
+            return -1;
+        }
 
-        /* Intermediate points required */
-        int anIntermediate[3];
+    nNetQuant = nBits;
 
-        /* Number of faces used in hit (1 to 4) */
-        int nFaces;
+    /* the cached evaluations came from the other weights */
+    CacheFlush(&cEval);
+    CacheFlush(&cpEval);
 
-        /* Number of pips used to hit */
-        int nPips;
-    } Inter;
+    return 0;
+}
 
-    const Inter *pi;
-    /* All ways to hit */
-    static const Inter aIntermediate[39] = {
-        {1, {0, 0, 0}, 1, 1},    /*  0: 1x hits 1 */
-        {1, {0, 0, 0}, 1, 2},    /*  1: 2x hits 2 */
-        {1, {1, 0, 0}, 2, 2},    /*  2: 11 hits 2 */
-        {1, {0, 0, 0}, 1, 3},    /*  3: 3x hits 3 */
-        {0, {1, 2, 0}, 2, 3},    /*  4: 21 hits 3 */
-        {1, {1, 2, 0}, 3, 3},    /*  5: 11 hits 3 */
-        {1, {0, 0, 0}, 1, 4},    /*  6: 4x hits 4 */
-        {0, {1, 3, 0}, 2, 4},    /*  7: 31 hits 4 */
-        {1, {2, 0, 0}, 2, 4},    /*  8: 22 hits 4 */
-        {1, {1, 2, 3}, 4, 4},    /*  9: 11 hits 4 */
-        {1, {0, 0, 0}, 1, 5},    /* 10: 5x hits 5 */
-        {0, {1, 4, 0}, 2, 5},    /* 11: 41 hits 5 */
-        {0, {2, 3, 0}, 2, 5},    /* 12: 32 hits 5 */
-        {1, {0, 0, 0}, 1, 6},    /* 13: 6x hits 6 */
-        {0, {1, 5, 0}, 2, 6},    /* 14: 51 hits 6 */
-        {0, {2, 4, 0}, 2, 6},    /* 15: 42 hits 6 */
-        {1, {3, 0, 0}, 2, 6},    /* 16: 33 hits 6 */
-        {1, {2, 4, 0}, 3, 6},    /* 17: 22 hits 6 */
-        {0, {1, 6, 0}, 2, 7},    /* 18: 61 hits 7 */
-        {0, {2, 5, 0}, 2, 7},    /* 19: 52 hits 7 */
-        {0, {3, 4, 0}, 2, 7},    /* 20: 43 hits 7 */
-        {0, {2, 6, 0}, 2, 8},    /* 21: 62 hits 8 */
-        {0, {3, 5, 0}, 2, 8},    /* 22: 53 hits 8 */
-        {1, {4, 0, 0}, 2, 8},    /* 23: 44 hits 8 */
-        {1, {2, 4, 6}, 4, 8},    /* 24: 22 hits 8 */
-        {0, {3, 6, 0}, 2, 9},    /* 25: 63 hits 9 */
-        {0, {4, 5, 0}, 2, 9},    /* 26: 54 hits 9 */
-        {1, {3, 6, 0}, 3, 9},    /* 27: 33 hits 9 */
-        {0, {4, 6, 0}, 2, 10},   /* 28: 64 hits 10 */
-        {1, {5, 0, 0}, 2, 10},   /* 29: 55 hits 10 */
-        {0, {5, 6, 0}, 2, 11},   /* 30: 65 hits 11 */
-        {1, {6, 0, 0}, 2, 12},   /* 31: 66 hits 12 */
-        {1, {4, 8, 0}, 3, 12},   /* 32: 44 hits 12 */
-        {1, {3, 6, 9}, 4, 12},   /* 33: 33 hits 12 */
-        {1, {5, 10, 0}, 3, 15},  /* 34: 55 hits 15 */
-        {1, {4, 8, 12}, 4, 16},  /* 35: 44 hits 16 */
-        {1, {6, 12, 0}, 3, 18},  /* 36: 66 hits 18 */
-        {1, {5, 10, 15}, 4, 20}, /* 37: 55 hits 20 */
-        {1, {6, 12, 18}, 4, 24}  /* 38: 66 hits 24 */
-    };
+extern int
+EvalGetQuantization(void)
+{
+    return nNetQuant;
+}
 
-    /* aaRoll[n] - All ways to hit with the n'th roll
-     * Each entry is an index into aIntermediate above.
-     */
+/* Play cPositions positions of random games from the initial position,
+ * deterministically, and compare their 0-ply evaluations with the float
+ * weights and with the weights quantized to nBits */
 
-    static const int aaRoll[21][4] = {
-        {0, 2, 5, 9},     /* 11 */
-        {1, 8, 17, 24},   /* 22 */
-        {3, 16, 27, 33},  /* 33 */
-        {6, 23, 32, 35},  /* 44 */
-        {10, 29, 34, 37}, /* 55 */
-        {13, 31, 36, 38}, /* 66 */
-        {0, 1, 4, -1},    /* 21 */
-        {0, 3, 7, -1},    /* 31 */
-        {1, 3, 12, -1},   /* 32 */
-        {0, 6, 11, -1},   /* 41 */
-        {1, 6, 15, -1},   /* 42 */
-        {3, 6, 20, -1},   /* 43 */
-        {0, 10, 14, -1},  /* 51 */
-        {1, 10, 19, -1},  /* 52 */
-        {3, 10, 22, -1},  /* 53 */
-        {6, 10, 26, -1},  /* 54 */
-        {0, 13, 18, -1},  /* 61 */
-        {1, 13, 21, -1},  /* 62 */
-        {3, 13, 25, -1},  /* 63 */
-        {6, 13, 28, -1},  /* 64 */
-        {10, 13, 30, -1}  /* 65 */
-    };
+extern int
+EvalQuantizationError(int nBits, unsigned int cPositions, quanterror aqe[N_CLASSES])
+{
+    static const unsigned int anStart[25] = {0, 0, 0, 0, 0, 5, 0, 3, 0, 0, 0, 0, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0};
+    int const nOld = nNetQuant;
+    TanBoard *aanBoard;
+    positionclass *apc;
+    float (*aar)[NUM_OUTPUTS];
+    randctx rcCorpus;
+    movelist ml;
+    cubeinfo ci;
+    unsigned int i;
+    int fGame = FALSE, f;
 
-    /* One roll stat */
+    memset(aqe, 0, N_CLASSES * sizeof(quanterror));
 
-    struct {
-        /* number of chequers this roll hits */
-        int nChequers;
+    aanBoard = g_malloc(cPositions * sizeof(TanBoard));
+    apc = g_malloc(cPositions * sizeof(positionclass));
+    aar = g_malloc(cPositions * sizeof(*aar));
+    if (!aanBoard || !apc || !aar) {
+        g_free(aanBoard);
+        g_free(apc);
+        g_free(aar);
+        return -1;
+    }
 
-        /* count of pips this roll hits */
-        int nPips;
-    } aRoll[21];
+    memset(&rcCorpus, 0, sizeof(rcCorpus));
+    irandinit(&rcCorpus, FALSE);
 
-    {
-        int np = 0;
+    for (i = 0; i < cPositions; i++) {
+        if (!fGame) {
+            memcpy(aanBoard[i][0], anStart, sizeof(anStart));
+            memcpy(aanBoard[i][1], anStart, sizeof(anStart));
+            fGame = TRUE;
+        } else {
+            int const n0 = irand(&rcCorpus) % 6 + 1;
+            int const n1 = irand(&rcCorpus) % 6 + 1;
+
+            memcpy(aanBoard[i], aanBoard[i - 1], sizeof(TanBoard));
+            GenerateMoves(&ml, (ConstTanBoard) aanBoard[i], n0, n1, FALSE);
+            if (ml.cMoves)
+                PositionFromKey(aanBoard[i], &ml.amMoves[irand(&rcCorpus) % ml.cMoves].key);
+            SwapSides(aanBoard[i]);
+        }
 
-        for (nOppBack = 24; nOppBack >= 0; --nOppBack) {
-            if (anBoardOpp[nOppBack]) {
-                break;
+        if ((apc[i] = ClassifyPosition((ConstTanBoard) aanBoard[i], VARIATION_STANDARD)) == CLASS_OVER) {
+            /* start a new game with the next position */
+            fGame = FALSE;
+            i--;
+        }
+    }
+
+    SetCubeInfoMoney(&ci, 1, -1, 0, FALSE, FALSE, VARIATION_STANDARD);
+
+    for (f = 0; f < 2; f++) {
+        if (EvalSetQuantization(f ? nBits : 0)) {
+            EvalSetQuantization(nOld);
+            g_free(aanBoard);
+            g_free(apc);
+            g_free(aar);
+            return -1;
+        }
+
+        for (i = 0; i < cPositions; i++) {
+            SSE_ALIGN(float arOutput[NUM_OUTPUTS]);
+
+            acef[apc[i]]((ConstTanBoard) aanBoard[i], arOutput, VARIATION_STANDARD, NULL);
+
+            if (!f)
+                memcpy(aar[i], arOutput, sizeof(arOutput));
+            else {
+                quanterror *pqe = aqe + apc[i];
+                float const r = fabsf(Utility(arOutput, &ci) - Utility(aar[i], &ci));
+
+                pqe->cPositions++;
+                pqe->rMax = MAX(pqe->rMax, r);
+                pqe->rMean += r;
             }
         }
+    }
+
+    for (i = 0; i < N_CLASSES; i++)
+        if (aqe[i].cPositions)
+            aqe[i].rMean /= aqe[i].cPositions;
+
+    EvalSetQuantization(nOld);
+
+    g_free(aanBoard);
+    g_free(apc);
+    g_free(aar);
+
+    return 0;
+}
+
+/* The point of the back chequer of anBoard[], -1 if there is none */
+static inline int
+BackChequer(const unsigned int anBoard[25])
+{
+    int n;
+
+    for (n = 24; n >= 0; --n)
+        if (anBoard[n])
+            break;
+
+    return n;
+}
 
-        nOppBack = 23 - nOppBack;
+/* Calculates the inputs of one player that depend on the opponent only
+ * through nOppBack, the point of its back chequer in our numbering. */
+
+static void
+CalculateOwnInputs(const unsigned int anBoard[25], int nOppBack, float afInput[])
+{
+    int i, j, k, n;
+    unsigned int fMade;
+
+    {
+        int np = 0;
 
         for (i = nOppBack + 1; i < 25; i++)
-            if (anBoard[i])
-                np += (i + 1 - nOppBack) * anBoard[i];
+            np += (i + 1 - nOppBack) * anBoard[i];
 
         afInput[I_BREAK_CONTACT] = (float)np / (15 + 152.0f);
     }
     {
         unsigned int p = 0;
 
-        for (i = 0; i < nOppBack; i++) {
-            if (anBoard[i])
-                p += (i + 1) * anBoard[i];
-        }
+        for (i = 0; i < nOppBack; i++)
+            p += (i + 1) * anBoard[i];
 
         afInput[I_FREEPIP] = (float)p / 100.0f;
     }
@@ -756,11 +976,9 @@ CalculateHalfInputs(const unsigned int anBoard[25], const unsigned int anBoardOp
         }
 
         for (; i >= 6; --i) {
-            if (anBoard[i]) {
-                int nc = anBoard[i];
-                no += nc;
-                t += i * nc;
-            }
+            int nc = anBoard[i];
+            no += nc;
+            t += i * nc;
         }
 
         for (i = 5; i >= 0; --i) {
@@ -783,13 +1001,7 @@ CalculateHalfInputs(const unsigned int anBoard[25], const unsigned int anBoardOp
     /* Back chequer */
 
     {
-        int nBack;
-
-        for (nBack = 24; nBack >= 0; --nBack) {
-            if (anBoard[nBack]) {
-                break;
-            }
-        }
+        int nBack = BackChequer(anBoard);
 
         afInput[I_BACK_CHEQUER] = (float)nBack / 24.0f;
 
@@ -825,130 +1037,351 @@ CalculateHalfInputs(const unsigned int anBoard[25], const unsigned int anBoardOp
         afInput[I_FORWARD_ANCHOR] = n == 0 ? 2.0f : (float)n / 6.0f;
     }
 
-    /* Piploss */
-
-    nBoard = 0;
-    for (i = 0; i < 6; i++)
-        if (anBoard[i] >= 2)
-            nBoard++;
-
-    memset(aHit, 0, sizeof(aHit));
-
-    /* for every point we'd consider hitting a blot on, */
+    fMade = MadePoints(anBoard);
 
-    for (i = (nBoard > 2) ? 23 : 21; i >= 0; i--)
-        /* if there's a blot there, then */
+    afInput[I_BACKESCAPES] = (float)Escapes(fMade, 23 - nOppBack) / 36.0f;
 
-        if (unlikely(anBoardOpp[i] == 1))
-            /* for every point beyond */
+    afInput[I_BACKRESCAPES] = (float)Escapes1(fMade, 23 - nOppBack) / 36.0f;
 
-            for (j = 24 - i; j < 25; j++)
-                /* if we have a hitter and are willing to hit */
+    for (n = 36, i = 15; i < 24 - nOppBack; i++)
+        if ((j = Escapes(fMade, i)) < n)
+            n = j;
 
-                if (anBoard[j] && !(j < 6 && anBoard[j] == 2))
-                    /* for every roll that can hit from that point */
+    afInput[I_ACONTAIN] = (float)(36 - n) / 36.0f;
+    afInput[I_ACONTAIN2] = afInput[I_ACONTAIN] * afInput[I_ACONTAIN];
 
-                    for (n = 0; n < 5; n++) {
-                        if (aanCombination[j - 24 + i][n] == -1)
-                            break;
+    if (nOppBack < 0) {
+        /* restart loop, point 24 should not be included */
+        i = 15;
+        n = 36;
+    }
 
-                        /* find the intermediate points required to play */
+    for (; i < 24; i++)
+        if ((j = Escapes(fMade, i)) < n)
+            n = j;
 
-                        pi = aIntermediate + aanCombination[j - 24 + i][n];
+    afInput[I_CONTAIN] = (float)(36 - n) / 36.0f;
+    afInput[I_CONTAIN2] = afInput[I_CONTAIN] * afInput[I_CONTAIN];
 
-                        if (pi->fAll) {
-                            /* if nFaces is 1, there are no intermediate points */
+    j = 0;
+    n = 0;
+    for (i = 0; i < 25; i++) {
+        int ni = anBoard[i];
 
-                            if (pi->nFaces > 1) {
-                                /* all the intermediate points are required */
+        j += ni;
+        n += i * ni;
+    }
 
-                                for (k = 0; k < 3 && pi->anIntermediate[k] > 0; k++)
-                                    if (anBoardOpp[i - pi->anIntermediate[k]] > 1)
-                                        /* point is blocked; look for other hits */
-                                        goto cannot_hit;
-                            }
-                        } else {
-                            /* either of two points are required */
+    // cppcheck-suppress zerodiv
+    n = (n + j - 1) / j;
 
-                            if (anBoardOpp[i - pi->anIntermediate[0]] > 1 && anBoardOpp[i - pi->anIntermediate[1]] > 1) {
-                                /* both are blocked; look for other hits */
-                                goto cannot_hit;
-                            }
-                        }
+    j = 0;
+    for (k = 0, i = n + 1; i < 25; i++) {
+        int ni = anBoard[i];
 
-                        /* enter this shot as available */
+        j += ni;
+        k += ni * (i - n) * (i - n);
+    }
 
-                        aHit[aanCombination[j - 24 + i][n]] |= 1 << j;
-                    cannot_hit:;
-                    }
+    if (j) {
+        k = (k + j - 1) / j;
+    }
 
-    memset(aRoll, 0, sizeof(aRoll));
+    afInput[I_MOMENT2] = (float)k / 400.0f;
 
-    if (!anBoard[24]) {
-        /* we're not on the bar; for each roll, */
+    {
+        int pa = -1;
+        int w = 0;
+        int tot = 0;
+        int np;
 
-        for (i = 0; i < 21; i++) {
-            n = -1; /* (hitter used) */
+        for (np = 23; np > 0; --np) {
+            if (unlikely(anBoard[np] >= 2)) {
+                if (pa == -1) {
+                    pa = np;
+                    continue;
+                }
 
-            /* for each way that roll hits, */
-            for (j = 0; j < 4; j++) {
-                int r = aaRoll[i][j];
+                {
+                    int d = pa - np;
 
-                if (unlikely(r < 0))
-                    break;
+                    static const int ac[23] = {11, 11, 11, 11, 11, 11, 11,
+                                               6, 5, 4, 3, 2,
+                                               0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 
-                if (likely(!aHit[r]))
-                    continue;
+                    w += ac[d] * anBoard[pa];
+                    tot += anBoard[pa];
+                }
+            }
+        }
 
-                pi = aIntermediate + r;
+        if (tot) {
+            afInput[I_BACKBONE] = 1.0f - ((float)w / ((float)tot * 11.0f));
+        } else {
+            afInput[I_BACKBONE] = 0.0f;
+        }
+    }
 
-                if (pi->nFaces == 1) {
-                    /* direct shot */
-                    k = msb32(aHit[r]);
-                    /* select the most advanced blot; if we still have
-                     * a chequer that can hit there */
+    {
+        unsigned int nAc = 0;
 
-                    if (n != k || anBoard[k] > 1)
-                        aRoll[i].nChequers++;
+        for (i = 18; i < 24; ++i) {
+            if (anBoard[i] > 1) {
+                ++nAc;
+            }
+        }
 
-                    n = k;
+        afInput[I_BACKG] = 0.0;
+        afInput[I_BACKG1] = 0.0;
 
-                    if (k - pi->nPips + 1 > aRoll[i].nPips)
-                        aRoll[i].nPips = k - pi->nPips + 1;
+        if (nAc >= 1) {
+            unsigned int tot = 0;
+            for (i = 18; i < 25; ++i) {
+                tot += anBoard[i];
+            }
 
-                    /* if rolling doubles, check for multiple
-                     * direct shots */
+            if (nAc > 1) {
+                /* g_assert( tot >= 4 ); */
 
-                    if (aaRoll[i][3] >= 0 && aHit[r] & ~(1 << k))
-                        aRoll[i].nChequers++;
+                afInput[I_BACKG] = (float)(tot - 3) / 4.0f;
+            } else { /* nAc == 1 */
+                afInput[I_BACKG1] = (float)tot / 8.0f;
+            }
+        }
+    }
+}
 
-                } else {
-                    /* indirect shot */
-                    if (!aRoll[i].nChequers)
-                        aRoll[i].nChequers = 1;
+/* Calculates I_PIPLOSS, I_P1 and I_P2 for one player. */
 
-                    /* find the most advanced hitter */
+static void
+CalculateShotInputs(const unsigned int anBoard[25], const unsigned int anBoardOpp[25], float afInput[])
+{
+    int i, j, k, l, n, aHit[39], nBoard;
+    unsigned int fRolls;
 
-                    k = msb32(aHit[r]);
+    /* One way to hit */
+    typedef struct {
+        /* if true, all intermediate points (if any) are required;
+         * if false, one of two intermediate points are required.
+         * Set to true for a direct hit, but that can be checked with
+         * nFaces == 1,
+         */
+        int fAll;
 
-                    if (k - pi->nPips + 1 > aRoll[i].nPips)
-                        aRoll[i].nPips = k - pi->nPips + 1;
+        /* Intermediate points required */
+        int anIntermediate[3];
 
-                    /* check for blots hit on intermediate points */
+        /* Number of faces used in hit (1 to 4) */
+        int nFaces;
 
-                    for (l = 0; l < 3 && pi->anIntermediate[l] > 0; l++)
-                        if (anBoardOpp[23 - k + pi->anIntermediate[l]] == 1) {
+        /* Number of pips used to hit */
+        int nPips;
+    } Inter;
 
-                            aRoll[i].nChequers++;
-                            break;
-                        }
+    const Inter *pi;
+    /* All ways to hit */
+    static const Inter aIntermediate[39] = {
+        {1, {0, 0, 0}, 1, 1},    /*  0: 1x hits 1 */
+        {1, {0, 0, 0}, 1, 2},    /*  1: 2x hits 2 */
+        {1, {1, 0, 0}, 2, 2},    /*  2: 11 hits 2 */
+        {1, {0, 0, 0}, 1, 3},    /*  3: 3x hits 3 */
+        {0, {1, 2, 0}, 2, 3},    /*  4: 21 hits 3 */
+        {1, {1, 2, 0}, 3, 3},    /*  5: 11 hits 3 */
+        {1, {0, 0, 0}, 1, 4},    /*  6: 4x hits 4 */
+        {0, {1, 3, 0}, 2, 4},    /*  7: 31 hits 4 */
+        {1, {2, 0, 0}, 2, 4},    /*  8: 22 hits 4 */
+        {1, {1, 2, 3}, 4, 4},    /*  9: 11 hits 4 */
+        {1, {0, 0, 0}, 1, 5},    /* 10: 5x hits 5 */
+        {0, {1, 4, 0}, 2, 5},    /* 11: 41 hits 5 */
+        {0, {2, 3, 0}, 2, 5},    /* 12: 32 hits 5 */
+        {1, {0, 0, 0}, 1, 6},    /* 13: 6x hits 6 */
+        {0, {1, 5, 0}, 2, 6},    /* 14: 51 hits 6 */
+        {0, {2, 4, 0}, 2, 6},    /* 15: 42 hits 6 */
+        {1, {3, 0, 0}, 2, 6},    /* 16: 33 hits 6 */
+        {1, {2, 4, 0}, 3, 6},    /* 17: 22 hits 6 */
+        {0, {1, 6, 0}, 2, 7},    /* 18: 61 hits 7 */
+        {0, {2, 5, 0}, 2, 7},    /* 19: 52 hits 7 */
+        {0, {3, 4, 0}, 2, 7},    /* 20: 43 hits 7 */
+        {0, {2, 6, 0}, 2, 8},    /* 21: 62 hits 8 */
+        {0, {3, 5, 0}, 2, 8},    /* 22: 53 hits 8 */
+        {1, {4, 0, 0}, 2, 8},    /* 23: 44 hits 8 */
+        {1, {2, 4, 6}, 4, 8},    /* 24: 22 hits 8 */
+        {0, {3, 6, 0}, 2, 9},    /* 25: 63 hits 9 */
+        {0, {4, 5, 0}, 2, 9},    /* 26: 54 hits 9 */
+        {1, {3, 6, 0}, 3, 9},    /* 27: 33 hits 9 */
+        {0, {4, 6, 0}, 2, 10},   /* 28: 64 hits 10 */
+        {1, {5, 0, 0}, 2, 10},   /* 29: 55 hits 10 */
+        {0, {5, 6, 0}, 2, 11},   /* 30: 65 hits 11 */
+        {1, {6, 0, 0}, 2, 12},   /* 31: 66 hits 12 */
+        {1, {4, 8, 0}, 3, 12},   /* 32: 44 hits 12 */
+        {1, {3, 6, 9}, 4, 12},   /* 33: 33 hits 12 */
+        {1, {5, 10, 0}, 3, 15},  /* 34: 55 hits 15 */
+        {1, {4, 8, 12}, 4, 16},  /* 35: 44 hits 16 */
+        {1, {6, 12, 0}, 3, 18},  /* 36: 66 hits 18 */
+        {1, {5, 10, 15}, 4, 20}, /* 37: 55 hits 20 */
+        {1, {6, 12, 18}, 4, 24}  /* 38: 66 hits 24 */
+    };
+
+    /* aaRoll[n] - All ways to hit with the n'th roll
+     * Each entry is an index into aIntermediate above.
+     */
+
+    static const int aaRoll[21][4] = {
+        {0, 2, 5, 9},     /* 11 */
+        {1, 8, 17, 24},   /* 22 */
+        {3, 16, 27, 33},  /* 33 */
+        {6, 23, 32, 35},  /* 44 */
+        {10, 29, 34, 37}, /* 55 */
+        {13, 31, 36, 38}, /* 66 */
+        {0, 1, 4, -1},    /* 21 */
+        {0, 3, 7, -1},    /* 31 */
+        {1, 3, 12, -1},   /* 32 */
+        {0, 6, 11, -1},   /* 41 */
+        {1, 6, 15, -1},   /* 42 */
+        {3, 6, 20, -1},   /* 43 */
+        {0, 10, 14, -1},  /* 51 */
+        {1, 10, 19, -1},  /* 52 */
+        {3, 10, 22, -1},  /* 53 */
+        {6, 10, 26, -1},  /* 54 */
+        {0, 13, 18, -1},  /* 61 */
+        {1, 13, 21, -1},  /* 62 */
+        {3, 13, 25, -1},  /* 63 */
+        {6, 13, 28, -1},  /* 64 */
+        {10, 13, 30, -1}  /* 65 */
+    };
+
+    /* One roll stat */
+
+    struct {
+        /* number of chequers this roll hits */
+        int nChequers;
+
+        /* count of pips this roll hits */
+        int nPips;
+    } aRoll[21];
+
+    /* Piploss */
+
+    nBoard = 0;
+    for (i = 0; i < 6; i++)
+        if (anBoard[i] >= 2)
+            nBoard++;
+
+    /* The shots are found a whole set of points at a time, in our
+     * numbering of the points: a blot of the opponent on point b is hit
+     * from point b + n with n pips if the intermediate points the roll
+     * needs are not blocked. */
+    {
+        unsigned int fHitter = 0, fBlot = 0, fBlock = 0, afBlocked[19];
+
+        /* the points we have a hitter on and are willing to hit from */
+        for (i = 0; i < 6; i++)
+            fHitter |= (unsigned int)(anBoard[i] && anBoard[i] != 2) << i;
+        for (; i < 25; i++)
+            fHitter |= (unsigned int)(anBoard[i] != 0) << i;
+
+        for (i = 0; i < 24; i++) {
+            fBlot |= (unsigned int)(anBoardOpp[23 - i] == 1) << i;
+            fBlock |= (unsigned int)(anBoardOpp[23 - i] > 1) << i;
+        }
+
+        /* with a weak board, don't consider hitting on points 23 and 24 */
+        if (nBoard <= 2)
+            fBlot &= ~3u;
+
+        /* afBlocked[n]: the points n pips behind a blocked one; no
+         * intermediate point is 0 pips away */
+        afBlocked[0] = 0;
+        for (n = 1; n < 19; n++)
+            afBlocked[n] = fBlock >> n;
+
+        for (n = 0; n < 39; n++) {
+            const int *an;
+            unsigned int f;
+
+            pi = aIntermediate + n;
+            an = pi->anIntermediate;
+
+            if (pi->fAll)
+                /* all the intermediate points (if any) are required */
+                f = fBlot & ~(afBlocked[an[0]] | afBlocked[an[1]] | afBlocked[an[2]]);
+            else
+                /* either of two points are required */
+                f = fBlot & ~(afBlocked[an[0]] & afBlocked[an[1]]);
+
+            aHit[n] = (int)((f << pi->nPips) & fHitter);
+        }
+    }
+
+    memset(aRoll, 0, sizeof(aRoll));
+
+    /* the rolls that hit anything at all, usually only a few */
+    for (fRolls = 0, i = 0; i < 21; i++)
+        if (aHit[aaRoll[i][0]] | aHit[aaRoll[i][1]] | aHit[aaRoll[i][2]] | (aaRoll[i][3] >= 0 ? aHit[aaRoll[i][3]] : 0))
+            fRolls |= 1u << i;
+
+    if (!anBoard[24]) {
+        /* we're not on the bar.  For each way to hit, find the most
+         * advanced hitter, the pips the opponent loses to it and whether
+         * it hits a second chequer: two blots with a direct shot of a
+         * double, or a blot on an intermediate point of an indirect one */
+        int anPips[39], afTwo[39];
+
+        for (n = 0; n < 39; n++) {
+            anPips[n] = afTwo[n] = 0;
+
+            if (!aHit[n])
+                continue;
+
+            pi = aIntermediate + n;
+            k = msb32(aHit[n]);
+            anPips[n] = k - pi->nPips + 1;
+
+            if (pi->nFaces == 1)
+                afTwo[n] = (aHit[n] & ~(1 << k)) != 0;
+            else
+                for (l = 0; l < 3 && pi->anIntermediate[l] > 0; l++)
+                    if (anBoardOpp[23 - k + pi->anIntermediate[l]] == 1) {
+                        afTwo[n] = 1;
+                        break;
+                    }
+        }
+
+        /* then for each roll, */
+
+        for (i = 0; i < 21; i++) {
+            const int *ar = aaRoll[i];
+
+            if (!(fRolls & (1u << i)))
+                continue;
+
+            aRoll[i].nPips = MAX(MAX(anPips[ar[0]], anPips[ar[1]]), anPips[ar[2]]);
+
+            if (ar[3] >= 0) {
+                /* doubles: a direct shot then three indirect ones */
+                aRoll[i].nPips = MAX(aRoll[i].nPips, anPips[ar[3]]);
+                aRoll[i].nChequers = 1 + (afTwo[ar[0]] | afTwo[ar[1]] | afTwo[ar[2]] | afTwo[ar[3]]);
+            } else {
+                /* two direct shots, each with its own chequer unless
+                 * both use the only one on the same point, then an
+                 * indirect shot */
+                int fTwo = afTwo[ar[2]];
+
+                if (aHit[ar[0]] && aHit[ar[1]]) {
+                    k = msb32(aHit[ar[1]]);
+                    fTwo |= msb32(aHit[ar[0]]) != k || anBoard[k] > 1;
                 }
+
+                aRoll[i].nChequers = 1 + fTwo;
             }
         }
     } else if (anBoard[24] == 1) {
         /* we have one on the bar; for each roll, */
 
         for (i = 0; i < 21; i++) {
+            if (!(fRolls & (1u << i)))
+                continue;
+
             n = 0; /* (free to use either die to enter) */
 
             for (j = 0; j < 4; j++) {
@@ -963,40 +1396,34 @@ CalculateHalfInputs(const unsigned int anBoard[25], const unsigned int anBoardOp
                 pi = aIntermediate + r;
 
                 if (pi->nFaces == 1) {
-                    /* direct shot */
+                    /* direct shot; for each hitter, from the most
+                     * advanced one */
+                    int fHitters;
 
-                    /* FIXME: There must be a more profitable way to use
-                     * the possibility of finding the msb quickly,
-                     * but I don't understand the code below. */
-#ifdef HAVE___BUILTIN_CLZ
-                    /* This shortcut is worthwhile only if msb32 is fast */
-                    for (k = msb32(aHit[r]); k > 0; k--) {
-#else
-                    for (k = 24; k > 0; k--) {
-#endif
-                        if (aHit[r] & (1 << k)) {
-                            /* if we need this die to enter, we can't hit elsewhere */
+                    for (fHitters = aHit[r] & ~1; fHitters; fHitters &= ~(1 << k)) {
+                        k = msb32(fHitters);
 
-                            if (n && k != 24)
-                                break;
-
-                            /* if this isn't a shot from the bar, the
-                             * other die must be used to enter */
+                        /* if we need this die to enter, we can't hit elsewhere */
 
-                            if (k != 24) {
-                                int npip = aIntermediate[aaRoll[i][1 - j]].nPips;
+                        if (n && k != 24)
+                            break;
 
-                                if (anBoardOpp[npip - 1] > 1)
-                                    break;
+                        /* if this isn't a shot from the bar, the
+                         * other die must be used to enter */
 
-                                n = 1;
-                            }
+                        if (k != 24) {
+                            int npip = aIntermediate[aaRoll[i][1 - j]].nPips;
 
-                            aRoll[i].nChequers++;
+                            if (anBoardOpp[npip - 1] > 1)
+                                break;
 
-                            if (k - pi->nPips + 1 > aRoll[i].nPips)
-                                aRoll[i].nPips = k - pi->nPips + 1;
+                            n = 1;
                         }
+
+                        aRoll[i].nChequers++;
+
+                        if (k - pi->nPips + 1 > aRoll[i].nPips)
+                            aRoll[i].nPips = k - pi->nPips + 1;
                     }
                 } else {
                     /* indirect shot -- consider from the bar only */
@@ -1085,67 +1512,41 @@ CalculateHalfInputs(const unsigned int anBoard[25], const unsigned int anBoardOp
         afInput[I_P1] = (float)n1 / 36.0f;
         afInput[I_P2] = (float)n2 / 36.0f;
     }
+}
 
-    afInput[I_BACKESCAPES] = (float)Escapes(anBoard, 23 - nOppBack) / 36.0f;
-
-    afInput[I_BACKRESCAPES] = (float)Escapes1(anBoard, 23 - nOppBack) / 36.0f;
+/* Calculates inputs for any contact position, for one player only.
+ *
+ * If afInputPrev is not NULL, it holds the inputs already calculated
+ * for the same anBoard[] against anBoardOppPrev[], usually a sibling in
+ * a move list where only the opponent has moved: the inputs that depend
+ * on the opponent through its back chequer alone are taken from there
+ * when that chequer has not moved. */
 
-    for (n = 36, i = 15; i < 24 - nOppBack; i++)
-        if ((j = Escapes(anBoard, i)) < n)
-            n = j;
+static void
+CalculateHalfInputs(const unsigned int anBoard[25], const unsigned int anBoardOpp[25], float afInput[],
+                    const unsigned int anBoardOppPrev[25], const float afInputPrev[])
+{
+    int i, j, n, nBackOpp;
+    unsigned int fMadeOpp;
 
-    afInput[I_ACONTAIN] = (float)(36 - n) / 36.0f;
-    afInput[I_ACONTAIN2] = afInput[I_ACONTAIN] * afInput[I_ACONTAIN];
+    nBackOpp = BackChequer(anBoardOpp);
 
-    if (nOppBack < 0) {
-        /* restart loop, point 24 should not be included */
-        i = 15;
-        n = 36;
-    }
+    if (afInputPrev && BackChequer(anBoardOppPrev) == nBackOpp)
+        /* the others are all overwritten below */
+        memcpy(afInput + I_BREAK_CONTACT, afInputPrev + I_BREAK_CONTACT,
+               (MORE_INPUTS - I_BREAK_CONTACT) * sizeof(float));
+    else
+        CalculateOwnInputs(anBoard, 23 - nBackOpp, afInput);
 
-    for (; i < 24; i++)
-        if ((j = Escapes(anBoard, i)) < n)
-            n = j;
+    CalculateShotInputs(anBoard, anBoardOpp, afInput);
 
-    afInput[I_CONTAIN] = (float)(36 - n) / 36.0f;
-    afInput[I_CONTAIN2] = afInput[I_CONTAIN] * afInput[I_CONTAIN];
+    fMadeOpp = MadePoints(anBoardOpp);
 
     for (n = 0, i = 6; i < 25; i++)
-        if (anBoard[i])
-            n += (i - 5) * anBoard[i] * Escapes(anBoardOpp, i);
+        n += (i - 5) * anBoard[i] * Escapes(fMadeOpp, i);
 
     afInput[I_MOBILITY] = (float)n / 3600.0f;
 
-    j = 0;
-    n = 0;
-    for (i = 0; i < 25; i++) {
-        int ni = anBoard[i];
-
-        if (ni) {
-            j += ni;
-            n += i * ni;
-        }
-    }
-
-    // cppcheck-suppress zerodiv
-    n = (n + j - 1) / j;
-
-    j = 0;
-    for (k = 0, i = n + 1; i < 25; i++) {
-        int ni = anBoard[i];
-
-        if (ni) {
-            j += ni;
-            k += ni * (i - n) * (i - n);
-        }
-    }
-
-    if (j) {
-        k = (k + j - 1) / j;
-    }
-
-    afInput[I_MOMENT2] = (float)k / 400.0f;
-
     if (anBoard[24] > 0) {
         int loss = 0;
         int two = anBoard[24] > 1;
@@ -1187,67 +1588,6 @@ CalculateHalfInputs(const unsigned int anBoard[25], const unsigned int anBoardOp
     }
 
     afInput[I_ENTER2] = (float)(36 - (n - 6) * (n - 6)) / 36.0f;
-
-    {
-        int pa = -1;
-        int w = 0;
-        int tot = 0;
-        int np;
-
-        for (np = 23; np > 0; --np) {
-            if (unlikely(anBoard[np] >= 2)) {
-                if (pa == -1) {
-                    pa = np;
-                    continue;
-                }
-
-                {
-                    int d = pa - np;
-
-                    static const int ac[23] = {11, 11, 11, 11, 11, 11, 11,
-                                               6, 5, 4, 3, 2,
-                                               0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-
-                    w += ac[d] * anBoard[pa];
-                    tot += anBoard[pa];
-                }
-            }
-        }
-
-        if (tot) {
-            afInput[I_BACKBONE] = 1.0f - ((float)w / ((float)tot * 11.0f));
-        } else {
-            afInput[I_BACKBONE] = 0.0f;
-        }
-    }
-
-    {
-        unsigned int nAc = 0;
-
-        for (i = 18; i < 24; ++i) {
-            if (anBoard[i] > 1) {
-                ++nAc;
-            }
-        }
-
-        afInput[I_BACKG] = 0.0;
-        afInput[I_BACKG1] = 0.0;
-
-        if (nAc >= 1) {
-            unsigned int tot = 0;
-            for (i = 18; i < 25; ++i) {
-                tot += anBoard[i];
-            }
-
-            if (nAc > 1) {
-                /* g_assert( tot >= 4 ); */
-
-                afInput[I_BACKG] = (float)(tot - 3) / 4.0f;
-            } else { /* nAc == 1 */
-                afInput[I_BACKG1] = (float)tot / 8.0f;
-            }
-        }
-    }
 }
 
 static void
@@ -1304,6 +1644,111 @@ CalculateRaceInputs(const TanBoard anBoard, float inputs[])
     }
 }
 
+/* The non-zero inputs of one side of CalculateRaceInputs(), in the same
+ * order, numbered from iHalf; return their number */
+static unsigned int
+CalculateRaceHalfActive(const unsigned int board[25], unsigned int iHalf, nninput an[])
+{
+    unsigned int menOff = 15, nCross = 0, i, c = 0;
+
+    g_assert(board[23] == 0 && board[24] == 0);
+
+    /* Points */
+    for (i = 0; i < 23; ++i) {
+        unsigned int const nc = board[i];
+
+        if (!nc)
+            continue;
+
+        menOff -= nc;
+
+        an[c].i = iHalf + i * 4 + MIN(nc, 3) - 1;
+        an[c].r = 1.0f;
+        c++;
+
+        if (nc > 3) {
+            an[c].i = iHalf + i * 4 + 3;
+            an[c].r = (float)(nc - 3) / 2.0f;
+            c++;
+        }
+    }
+
+    /* Men off */
+    if (menOff >= 1 && menOff <= 14) {
+        an[c].i = iHalf + RI_OFF + menOff - 1;
+        an[c].r = 1.0f;
+        c++;
+    }
+
+    for (i = 6; i < 24; ++i)
+        nCross += board[i] * (i / 6);
+
+    if (nCross) {
+        an[c].i = iHalf + RI_NCROSS;
+        an[c].r = (float)nCross / 10.0f;
+        c++;
+    }
+
+    return c;
+}
+
+/*
+ * The race inputs of a side only depend on its own chequers, and in a
+ * search the side that is not on roll keeps the same ones across all the
+ * rolls, so the halves are remembered in a small direct-mapped table
+ * keyed by the 23 points, 4 bits each.  With 15 chequers there are at
+ * most 16 active inputs per side.  A zeroed entry stands for the empty
+ * side, which has no active inputs, so the table needs no setup.  Each
+ * thread has its own table, which it reads and writes without locks.
+ */
+static unsigned int
+RaceHalfActive(const unsigned int board[25], unsigned int iHalf, nninput an[])
+{
+    uint32_t aKey[3] = { 0, 0, 0 };
+    racehalf *prh;
+    unsigned int i, c;
+
+    for (i = 0; i < 8; ++i) {
+        aKey[0] |= board[i] << (i * 4);
+        aKey[1] |= board[i + 8] << (i * 4);
+        aKey[2] |= board[i + 16] << (i * 4);    /* board[23] is 0 in a race */
+    }
+
+    prh = MT_GetTLD()->aRaceHalf + ((((aKey[0] * 0xcc9e2d51u) ^ aKey[1]) * 0x1b873593u ^ aKey[2]) * 0x85ebca6bu
+                                    >> (32 - RACE_HALF_CACHE_BITS));
+
+    if (prh->aKey[0] == aKey[0] && prh->aKey[1] == aKey[1] && prh->aKey[2] == aKey[2]) {
+        for (i = 0; i < prh->c; ++i) {
+            an[i].i = iHalf + prh->an[i].i;
+            an[i].r = prh->an[i].r;
+        }
+        return prh->c;
+    }
+
+    c = CalculateRaceHalfActive(board, iHalf, an);
+
+    if (c <= MAX_RACE_HALF_CACHED) {
+        memcpy(prh->aKey, aKey, sizeof(aKey));
+        prh->c = c;
+        for (i = 0; i < c; ++i) {
+            prh->an[i].i = an[i].i - iHalf;
+            prh->an[i].r = an[i].r;
+        }
+    }
+
+    return c;
+}
+
+/* The non-zero inputs of CalculateRaceInputs(), in the same order, for
+ * NeuralNetEvaluateSparse(); return their number */
+static unsigned int
+CalculateRaceActive(const TanBoard anBoard, nninput an[])
+{
+    unsigned int c = RaceHalfActive(anBoard[0], 0, an);
+
+    return c + RaceHalfActive(anBoard[1], HALF_RACE_INPUTS, an + c);
+}
+
 /* baseInputs() is now in lib/inputs.c */
 
 static void
@@ -1360,53 +1805,74 @@ menOffNonCrashed(const unsigned int *anBoard, float *afInput)
     }
 }
 
-/* Calculates contact neural net inputs from the board position. */
+/* Calculates the inputs of both players that follow the NN_BOARD_INPUTS
+ * ones.  anBoardPrev and arInputPrev, if not NULL, are a position and its
+ * inputs calculated just before, usually the previous move of a move
+ * list: a player that has the same chequers there starts from the inputs
+ * of that position (see CalculateHalfInputs()). */
+
+static void
+CalculateHalvesInputs(const TanBoard anBoard, float arInput[], const TanBoard anBoardPrev, const float arInputPrev[])
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        /* the inputs of player 1 - i against player i */
+        float *b = arInput + MINPPERPOINT * 25 * 2 + i * MORE_INPUTS;
+        const float *bPrev = NULL;
+
+        if (anBoardPrev && !memcmp(anBoard[1 - i], anBoardPrev[1 - i], sizeof(anBoard[1 - i])))
+            bPrev = arInputPrev + MINPPERPOINT * 25 * 2 + i * MORE_INPUTS;
+
+        CalculateHalfInputs(anBoard[1 - i], anBoard[i], b, anBoardPrev ? anBoardPrev[i] : NULL, bPrev);
+    }
+}
+
+/* Calculates the contact neural net inputs that follow the
+ * NN_BOARD_INPUTS ones from baseInputs(), see CalculateHalvesInputs(). */
 
 static void
-CalculateContactInputs(const TanBoard anBoard, float arInput[])
+CalculateContactMoreInputs(const TanBoard anBoard, float arInput[], const TanBoard anBoardPrev, const float arInputPrev[])
 {
-    baseInputs(anBoard, arInput);
+    float *b = arInput + MINPPERPOINT * 25 * 2;
 
-    {
-        float *b = arInput + MINPPERPOINT * 25 * 2;
+    /* I accidentally switched sides (0 and 1) when I trained the net */
+    menOffNonCrashed(anBoard[0], b + I_OFF1);
+    menOffNonCrashed(anBoard[1], b + MORE_INPUTS + I_OFF1);
 
-        /* I accidentally switched sides (0 and 1) when I trained the net */
-        menOffNonCrashed(anBoard[0], b + I_OFF1);
+    CalculateHalvesInputs(anBoard, arInput, anBoardPrev, arInputPrev);
+}
 
-        CalculateHalfInputs(anBoard[1], anBoard[0], b);
-    }
+/* Calculates the crashed neural net inputs that follow the
+ * NN_BOARD_INPUTS ones from baseInputs(), see CalculateHalvesInputs(). */
 
-    {
-        float *b = arInput + (MINPPERPOINT * 25 * 2 + MORE_INPUTS);
+static void
+CalculateCrashedMoreInputs(const TanBoard anBoard, float arInput[], const TanBoard anBoardPrev, const float arInputPrev[])
+{
+    float *b = arInput + MINPPERPOINT * 25 * 2;
 
-        menOffNonCrashed(anBoard[1], b + I_OFF1);
+    menOffAll(anBoard[1], b + I_OFF1);
+    menOffAll(anBoard[0], b + MORE_INPUTS + I_OFF1);
 
-        CalculateHalfInputs(anBoard[0], anBoard[1], b);
-    }
+    CalculateHalvesInputs(anBoard, arInput, anBoardPrev, arInputPrev);
 }
 
-/* Calculates crashed neural net inputs from the board position. */
+/* Calculates contact neural net inputs from the board position. */
 
 static void
-CalculateCrashedInputs(const TanBoard anBoard, float arInput[])
+CalculateContactInputs(const TanBoard anBoard, float arInput[])
 {
     baseInputs(anBoard, arInput);
+    CalculateContactMoreInputs(anBoard, arInput, NULL, NULL);
+}
 
-    {
-        float *b = arInput + MINPPERPOINT * 25 * 2;
-
-        menOffAll(anBoard[1], b + I_OFF1);
-
-        CalculateHalfInputs(anBoard[1], anBoard[0], b);
-    }
-
-    {
-        float *b = arInput + (MINPPERPOINT * 25 * 2 + MORE_INPUTS);
-
-        menOffAll(anBoard[0], b + I_OFF1);
+/* Calculates crashed neural net inputs from the board position. */
 
-        CalculateHalfInputs(anBoard[0], anBoard[1], b);
-    }
+static void
+CalculateCrashedInputs(const TanBoard anBoard, float arInput[])
+{
+    baseInputs(anBoard, arInput);
+    CalculateCrashedMoreInputs(anBoard, arInput, NULL, NULL);
 }
 
 extern void
@@ -1917,16 +2383,20 @@ EvalRace(const TanBoard anBoard, float arOutput[], const bgvariation bgv, NNStat
 {
     SSE_ALIGN(float arInput[NUM_RACE_INPUTS]);
 
-    CalculateRaceInputs(anBoard, arInput);
-
-#if defined(USE_SIMD_INSTRUCTIONS)
-    // cppcheck-suppress duplicateExpression
-    if (NeuralNetEvaluateSSE(&nnRace, arInput, arOutput, nnStates ? nnStates + (CLASS_RACE - CLASS_RACE) : NULL))
-#else
     // cppcheck-suppress duplicateExpression
-    if (NeuralNetEvaluate(&nnRace, arInput, arOutput, nnStates ? nnStates + (CLASS_RACE - CLASS_RACE) : NULL))
-#endif
-        return -1;
+    if (nnStates && nnStates[CLASS_RACE - CLASS_RACE].state != NNSTATE_NONE) {
+        CalculateRaceInputs(anBoard, arInput);
+
+        // cppcheck-suppress duplicateExpression
+        if (NeuralNetEvaluate(&nnRace, arInput, arOutput, nnStates + (CLASS_RACE - CLASS_RACE)))
+            return -1;
+    } else {
+        nninput an[MAX_RACE_ACTIVE];
+        unsigned int const c = CalculateRaceActive(anBoard, an);
+
+        if (NeuralNetEvaluateSparse(&nnRace, 1, an, MAX_RACE_ACTIVE, &c, arOutput))
+            return -1;
+    }
 
     /* special evaluation of backgammons overrides net output */
 
@@ -1942,14 +2412,14 @@ EvalContact(const TanBoard anBoard, float arOutput[], const bgvariation UNUSED(b
 {
     SSE_ALIGN(float arInput[NUM_INPUTS]);
 
-    CalculateContactInputs(anBoard, arInput);
+    if (nnStates && nnStates[CLASS_CONTACT - CLASS_RACE].state != NNSTATE_NONE) {
+        CalculateContactInputs(anBoard, arInput);
+        return NeuralNetEvaluate(&nnContact, arInput, arOutput, nnStates + (CLASS_CONTACT - CLASS_RACE));
+    }
+
+    CalculateContactMoreInputs(anBoard, arInput, NULL, NULL);
 
-#if defined(USE_SIMD_INSTRUCTIONS)
-    return NeuralNetEvaluateSSE(&nnContact, arInput, arOutput,
-                                nnStates ? nnStates + (CLASS_CONTACT - CLASS_RACE) : NULL);
-#else
-    return NeuralNetEvaluate(&nnContact, arInput, arOutput, nnStates ? nnStates + (CLASS_CONTACT - CLASS_RACE) : NULL);
-#endif
+    return NeuralNetEvaluateBoard(&nnContact, 1, (const TanBoard *)anBoard, arInput, arOutput);
 }
 
 static int
@@ -1957,14 +2427,14 @@ EvalCrashed(const TanBoard anBoard, float arOutput[], const bgvariation UNUSED(b
 {
     SSE_ALIGN(float arInput[NUM_INPUTS]);
 
-    CalculateCrashedInputs(anBoard, arInput);
+    if (nnStates && nnStates[CLASS_CRASHED - CLASS_RACE].state != NNSTATE_NONE) {
+        CalculateCrashedInputs(anBoard, arInput);
+        return NeuralNetEvaluate(&nnCrashed, arInput, arOutput, nnStates + (CLASS_CRASHED - CLASS_RACE));
+    }
+
+    CalculateCrashedMoreInputs(anBoard, arInput, NULL, NULL);
 
-#if defined(USE_SIMD_INSTRUCTIONS)
-    return NeuralNetEvaluateSSE(&nnCrashed, arInput, arOutput,
-                                nnStates ? nnStates + (CLASS_CRASHED - CLASS_RACE) : NULL);
-#else
-    return NeuralNetEvaluate(&nnCrashed, arInput, arOutput, nnStates ? nnStates + (CLASS_CRASHED - CLASS_RACE) : NULL);
-#endif
+    return NeuralNetEvaluateBoard(&nnCrashed, 1, (const TanBoard *)anBoard, arInput, arOutput);
 }
 
 extern int
@@ -2123,12 +2593,19 @@ EvalKey(const evalcontext *pec, const int nPlies, const cubeinfo *pci, int fCube
      * Bit 25   : fCrawford
      * Bit 26   : fJacoby
      * Bit 27   : fBeavers
+     * Bit 28   : fBearoffPlay
+     * Bit 29   : pec->nPlies >= 2, which selects the cube efficiency of
+     *            the leaves (see EvalEfficiency())
      */
 
     iKey = (nPlies | (pec->fCubeful << 4) | (pci->fMove << 5));
 
     if (nPlies)
-        iKey ^= ((pec->fUsePrune) << 6);
+        iKey ^= ((pec->fUsePrune) << 6) ^ ((pec->fBearoffPlay) << 28);
+
+    /* cubeful equities, and the moves they pick below nPlies */
+    if (fCubefulEquity || (nPlies && pec->fCubeful))
+        iKey ^= (pec->nPlies >= 2) << 29;
 
     if (nPlies || fCubefulEquity) {
         /* In match play, the score and cube value and position are important. */
@@ -2144,7 +2621,7 @@ EvalKey(const evalcontext *pec, const int nPlies, const cubeinfo *pci, int fCube
                 ((pci->fCubeOwner < 0 ? 2 : pci->fCubeOwner == pci->fMove) << 23) ^ (pci->fJacoby << 26) ^ (pci->fBeavers << 27);
 
         if (fCubefulEquity)
-            iKey ^= 0x6a47b47e;
+            iKey ^= CACHE_KEY_CUBEFUL;
     }
 
     return iKey;
@@ -2453,14 +2930,74 @@ ApplyMove(TanBoard anBoard, const int anMove[8], const int fCheckLegal)
     return 0;
 }
 
+/*
+ * The moves found so far are indexed by key in an open addressing table,
+ * so that SaveMoves() spots a duplicate without scanning the list.  A
+ * slot holds the index of a move tagged with the stamp of its list, and
+ * starting a new list just takes a new stamp; the table is only cleared
+ * when the stamps wrap around.
+ */
+#define MOVE_INDEX_SHIFT 12     /* MAX_INCOMPLETE_MOVES < 1 << 12 */
+
 static void
-SaveMoves(movelist *pml, unsigned int cMoves, unsigned int cPip, int anMoves[], const TanBoard anBoard, int fPartial)
+ResetMoveIndex(void)
+{
+    ThreadLocalData *tld = MT_GetTLD();
+
+    if (++tld->nMoveIndexStamp == 1u << (32 - MOVE_INDEX_SHIFT)) {
+        memset(tld->aMoveIndex, 0, sizeof(unsigned int) * MOVE_INDEX_SIZE);
+        tld->nMoveIndexStamp = 1;
+    }
+}
+
+/* Look *pkey up in the index of the moves of pml, and add it as move
+ * pml->cMoves if it is not there; return the move */
+static move *
+IndexMove(movelist *pml, const positionkey *pkey)
+{
+    unsigned int i, h;
+    ThreadLocalData *tld = MT_GetTLD();
+
+    h = pkey->data[0];
+    for (i = 1; i < 7; i++)
+        h = (h ^ pkey->data[i]) * 0x9e3779b1u;
+
+    for (h = (h ^ h >> 16) & (MOVE_INDEX_SIZE - 1);; h = (h + 1) & (MOVE_INDEX_SIZE - 1)) {
+        unsigned int const n = tld->aMoveIndex[h];
+        move *pm;
+
+        if (n >> MOVE_INDEX_SHIFT != tld->nMoveIndexStamp) {
+            /* a free slot: the position is new */
+            tld->aMoveIndex[h] = tld->nMoveIndexStamp << MOVE_INDEX_SHIFT | pml->cMoves;
+            return pml->amMoves + pml->cMoves;
+        }
+
+        pm = &(pml->amMoves[n & ((1u << MOVE_INDEX_SHIFT) - 1)]);
+
+        if (EqualKeys(*pkey, pm->key))
+            return pm;
+    }
+}
+
+/* A play found by GenerateMovesSub(), its cMoves chequers moved cPip pips
+ * in all from the position before leading to *pkey; return non-zero to
+ * stop the search */
+typedef int (*moveleaf) (void *p, unsigned int cMoves, unsigned int cPip, const int anMoves[],
+                         const positionkey *pkey);
+
+typedef struct {
+    movelist *pml;
+    int fPartial;
+} movesave;
+
+static int
+SaveMoves(void *p, unsigned int cMoves, unsigned int cPip, const int anMoves[], const positionkey *pkey)
 {
+    movelist *const pml = ((movesave *)p)->pml;
     unsigned int i, j;
     move *pm;
-    positionkey key;
 
-    if (fPartial) {
+    if (((movesave *)p)->fPartial) {
         /* Save all moves, even incomplete ones */
         if (cMoves > pml->cMaxMoves)
             pml->cMaxMoves = cMoves;
@@ -2472,38 +3009,34 @@ SaveMoves(movelist *pml, unsigned int cMoves, unsigned int cPip, int anMoves[],
          * chequers or pips than those already found, it is illegal; if
          * it plays more, the old moves are illegal. */
         if (cMoves < pml->cMaxMoves || cPip < pml->cMaxPips)
-            return;
+            return 0;
 
-        if (cMoves > pml->cMaxMoves || cPip > pml->cMaxPips)
+        if (cMoves > pml->cMaxMoves || cPip > pml->cMaxPips) {
             pml->cMoves = 0;
+            ResetMoveIndex();
+        }
 
         pml->cMaxMoves = cMoves;
         pml->cMaxPips = cPip;
     }
 
-    PositionKey(anBoard, &key);
-
-    for (i = 0; i < pml->cMoves; i++) {
-
-        pm = &(pml->amMoves[i]);
+    pm = IndexMove(pml, pkey);
 
-        if (EqualKeys(key, pm->key)) {
-            if (cMoves > pm->cMoves || cPip > pm->cPips) {
-                for (j = 0; j < cMoves * 2; j++)
-                    pm->anMove[j] = anMoves[j] > -1 ? anMoves[j] : -1;
+    if (pm != pml->amMoves + pml->cMoves) {
+        /* a duplicate */
+        if (cMoves > pm->cMoves || cPip > pm->cPips) {
+            for (j = 0; j < cMoves * 2; j++)
+                pm->anMove[j] = anMoves[j] > -1 ? anMoves[j] : -1;
 
-                if (cMoves < 4)
-                    pm->anMove[cMoves * 2] = -1;
+            if (cMoves < 4)
+                pm->anMove[cMoves * 2] = -1;
 
-                pm->cMoves = cMoves;
-                pm->cPips = cPip;
-            }
-
-            return;
+            pm->cMoves = cMoves;
+            pm->cPips = cPip;
         }
-    }
 
-    pm = pml->amMoves + pml->cMoves;
+        return 0;
+    }
 
     for (i = 0; i < cMoves * 2; i++)
         pm->anMove[i] = anMoves[i] > -1 ? anMoves[i] : -1;
@@ -2511,11 +3044,11 @@ SaveMoves(movelist *pml, unsigned int cMoves, unsigned int cPip, int anMoves[],
     if (cMoves < 4)
         pm->anMove[cMoves * 2] = -1;
 
-    CopyKey(key, pm->key);
+    CopyKey(*pkey, pm->key);
 
     pm->cMoves = cMoves;
     pm->cPips = cPip;
-    pm->cmark = CMARK_NONE;
+    pm->etMove = EVAL_NONE;
 
     for (i = 0; i < NUM_OUTPUTS; i++)
         pm->arEvalMove[i] = 0.0;
@@ -2523,75 +3056,154 @@ SaveMoves(movelist *pml, unsigned int cMoves, unsigned int cPip, int anMoves[],
     pml->cMoves++;
 
     g_assert(pml->cMoves < MAX_INCOMPLETE_MOVES);
+
+    return 0;
 }
 
-static int
-LegalMove(const TanBoard anBoard, int iSrc, int nPips)
+/*
+ * Move generation works on the key of the position, where the chequers
+ * of a point are a 4 bit count (see PositionKey()), and on a mask of the
+ * points the player on roll occupies; playing a chequer only changes a
+ * couple of counts, so nothing is copied but the key.  The opponent's
+ * points that block us cannot change during a move (we can only hit
+ * blots), so the points we can land on are masks computed once per roll.
+ */
+
+/* The count of point i of the player on roll (24 is the bar) */
+#define KEY_POINT(key, i) ((key).data[(i) < 24 ? (i) >> 3 : 6] >> ((i) < 24 ? ((i) & 7) * 4 : 4) & 0x0f)
+
+typedef struct {
+    positionkey key;
+    unsigned int fOcc;          /* points 0..24 holding our chequers */
+    unsigned int fMoves;        /* points still to try moving from */
+    int fUsed;                  /* a chequer has been moved from this position */
+} genframe;
+
+/* Set the chequers of pf that can be moved nRoll pips in pf->fMoves,
+ * none above iPip unless one is on the bar; afOpen[n] holds the points
+ * not blocked by the opponent shifted up by n, the points a chequer can
+ * move n pips from without bearing off */
+static void
+SubMoves(genframe *pf, unsigned int iPip, unsigned int nRoll, const unsigned int afOpen[7])
 {
+    unsigned int const fOcc = pf->fOcc;
 
-    int nBack;
-    const int iDest = iSrc - nPips;
+    pf->fUsed = FALSE;
 
-    if (iDest >= 0) { /* Here we can do the Chris rule check */
-        return (anBoard[0][23 - iDest] < 2);
+    if (fOcc & (1u << 24)) {
+        /* we have to enter first */
+        pf->fMoves = afOpen[nRoll] & (1u << 24);
+        return;
     }
-    /* otherwise, attempting to bear off */
 
-    for (nBack = 24; nBack > 0; nBack--)
-        if (anBoard[1][nBack] > 0)
-            break;
+    pf->fMoves = fOcc & afOpen[nRoll];
+
+    if (!(fOcc >> 6)) {
+        /* all home: bear off exactly, or the back chequer with a larger roll */
+        unsigned int const nBack = msb32((int)fOcc);
+
+        pf->fMoves |= fOcc & ((1u << (nRoll - 1)) | ((1u << nBack) & ((1u << nRoll) - 1)));
+    }
 
-    return (nBack <= 5 && (iSrc == nBack || iDest == -1));
+    pf->fMoves &= (2u << iPip) - 1;
 }
 
-static int
-GenerateMovesSub(movelist *pml, int anRoll[], int nMoveDepth,
-                 int iPip, int cPip, const TanBoard anBoard, int anMoves[], int fPartial)
+/* Move a chequer of pf nRoll pips from point i into pfNew */
+static void
+PlaySubMove(const genframe *pf, unsigned int i, unsigned int nRoll, genframe *pfNew)
 {
-    int i, fUsed = 0;
-    TanBoard anBoardNew;
+    int const iDest = (int)i - (int)nRoll;
 
-    if (nMoveDepth > 3 || !anRoll[nMoveDepth])
-        return TRUE;
+    pfNew->key = pf->key;
+    pfNew->fOcc = pf->fOcc;
 
-    if (anBoard[1][24]) { /* on bar */
-        if (anBoard[0][anRoll[nMoveDepth] - 1] >= 2)
-            return TRUE;
+    if (i < 24)
+        pfNew->key.data[i >> 3] -= 1u << ((i & 7) * 4);
+    else
+        pfNew->key.data[6] -= 1u << 4;
 
-        anMoves[nMoveDepth * 2] = 24;
-        anMoves[nMoveDepth * 2 + 1] = 24 - anRoll[nMoveDepth];
+    if (KEY_POINT(pfNew->key, i) == 0)
+        pfNew->fOcc &= ~(1u << i);
 
-        for (i = 0; i < 25; i++) {
-            anBoardNew[0][i] = anBoard[0][i];
-            anBoardNew[1][i] = anBoard[1][i];
+    if (iDest < 0)
+        return;
+
+    {
+        unsigned int const iOpp = 23 - (unsigned int)iDest;
+        unsigned int *const pn = pfNew->key.data + 3 + (iOpp >> 3);
+
+        if ((*pn >> ((iOpp & 7) * 4) & 0x0f) == 1) {
+            /* hit */
+            *pn -= 1u << ((iOpp & 7) * 4);
+            pfNew->key.data[6]++;
         }
+    }
+
+    pfNew->key.data[iDest >> 3] += 1u << ((iDest & 7) * 4);
+    pfNew->fOcc |= 1u << iDest;
+}
 
-        ApplySubMove(anBoardNew, 24, anRoll[nMoveDepth], TRUE);
+/* Pass to pfLeaf all the ways of playing anRoll[] from the position with
+ * key *pkey, in the order a depth first search from the highest points
+ * finds them; a play is passed when no die can be played after it, and
+ * with fPartial also when one can.  Return non-zero if pfLeaf stopped
+ * the search. */
+static int
+GenerateMovesSub(const int anRoll[4], const positionkey *pkey, unsigned int fOcc,
+                 const unsigned int afOpen[7], int fPartial, moveleaf pfLeaf, void *p)
+{
+    genframe af[5];
+    int anMoves[8];
+    unsigned int acPip[5];
+    unsigned int d;
+    int const fDoubles = anRoll[0] == anRoll[1];
 
-        if (GenerateMovesSub(pml, anRoll, nMoveDepth + 1, 23, cPip + anRoll[nMoveDepth], (ConstTanBoard)anBoardNew, anMoves, fPartial))
-            SaveMoves(pml, nMoveDepth + 1, cPip + anRoll[nMoveDepth], anMoves, (ConstTanBoard)anBoardNew, fPartial);
+    if (!anRoll[0])
+        return 0;
 
-        return fPartial;
-    } else {
-        for (i = iPip; i >= 0; i--)
-            if (anBoard[1][i] && LegalMove(anBoard, i, anRoll[nMoveDepth])) {
-                anMoves[nMoveDepth * 2] = i;
-                anMoves[nMoveDepth * 2 + 1] = i - anRoll[nMoveDepth];
+    acPip[0] = 0;
+    for (d = 0; d < 4; d++)
+        acPip[d + 1] = acPip[d] + (unsigned int)anRoll[d];
 
-                memcpy(anBoardNew, anBoard, sizeof(anBoardNew));
+    af[0].key = *pkey;
+    af[0].fOcc = fOcc;
+    SubMoves(af, 23, (unsigned int)anRoll[0], afOpen);
 
-                ApplySubMove(anBoardNew, i, anRoll[nMoveDepth], TRUE);
+    /* af[d] is the position before the d-th chequer is moved */
+    d = 0;
+    for (;;) {
+        genframe *const pf = af + d;
 
-                if (GenerateMovesSub(pml, anRoll, nMoveDepth + 1,
-                                     anRoll[0] == anRoll[1] ? i : 23,
-                                     cPip + anRoll[nMoveDepth], (ConstTanBoard)anBoardNew, anMoves, fPartial))
-                    SaveMoves(pml, nMoveDepth + 1, cPip + anRoll[nMoveDepth], anMoves, (ConstTanBoard)anBoardNew, fPartial);
+        if (pf->fMoves) {
+            unsigned int const i = (unsigned int)msb32((int)pf->fMoves);
 
-                fUsed = 1;
+            pf->fMoves &= ~(1u << i);
+            pf->fUsed = TRUE;
+
+            anMoves[d * 2] = (int)i;
+            anMoves[d * 2 + 1] = (int)i - anRoll[d];
+
+            PlaySubMove(pf, i, (unsigned int)anRoll[d], pf + 1);
+
+            if (d == 3 || !anRoll[d + 1]) {
+                if (pfLeaf(p, d + 1, acPip[d + 1], anMoves, &pf[1].key))
+                    return -1;
+            } else {
+                SubMoves(pf + 1, fDoubles && i < 24 ? i : 23, (unsigned int)anRoll[d + 1], afOpen);
+                d++;
             }
-    }
+        } else {
+            int const fSave = !pf->fUsed || fPartial;
+
+            if (d == 0)
+                return 0;
 
-    return !fUsed || fPartial;
+            d--;
+
+            if (fSave && pfLeaf(p, d + 1, acPip[d + 1], anMoves, &pf->key))
+                return -1;
+        }
+    }
 }
 
 extern int
@@ -2608,9 +3220,13 @@ CompareMovesGeneral(const move *pm0, const move *pm1)
     TanBoard board[2];
     int back[2] = {-1, -1};
     int cleft[2] = {0, 0};
-    int a, b;
+    int a, b, i;
 
-    int i = cmp_evalsetup(&pm0->esMove, &pm1->esMove);
+    /* as cmp_evalsetup(), rollouts compare equal */
+    if (pm0->etMove != pm1->etMove)
+        i = pm0->etMove < pm1->etMove ? -1 : 1;
+    else
+        i = pm0->etMove == EVAL_EVAL ? cmp_evalcontext(&pm0->ecMove, &pm1->ecMove) : 0;
 
     if (i)
         return -i; /* sort descending */
@@ -2653,29 +3269,153 @@ CompareMovesGeneral(const move *pm0, const move *pm1)
     return (back[0] > back[1] ? 1 : -1);
 }
 
-extern int
-GenerateMoves(movelist *pml, const TanBoard anBoard, int n0, int n1, int fPartial)
+/* Set up the arguments of GenerateMovesSub() for playing n0 and n1 in
+ * anBoard */
+static void
+GenerateMovesInit(const TanBoard anBoard, int n0, int n1, int anRoll[4], positionkey *pkey,
+                  unsigned int *pfOcc, unsigned int afOpen[7])
 {
+    unsigned int fOpen = 0, fOcc = 0, i;
 
-    int anRoll[4], anMoves[8];
     anRoll[0] = n0;
     anRoll[1] = n1;
 
     anRoll[2] = anRoll[3] = ((n0 == n1) ? n0 : 0);
 
+    PositionKey(anBoard, pkey);
+
+    for (i = 0; i < 25; i++) {
+        if (anBoard[1][i])
+            fOcc |= 1u << i;
+        if (i < 24 && anBoard[0][23 - i] < 2)
+            fOpen |= 1u << i;
+    }
+
+    for (i = 1; i < 7; i++)
+        afOpen[i] = fOpen << i;
+
+    *pfOcc = fOcc;
+}
+
+extern int
+GenerateMoves(movelist *pml, const TanBoard anBoard, int n0, int n1, int fPartial)
+{
+
+    int anRoll[4];
+    positionkey key;
+    unsigned int afOpen[7], fOcc;
+    movesave ms;
+
+    GenerateMovesInit(anBoard, n0, n1, anRoll, &key, &fOcc, afOpen);
+
     pml->cMoves = pml->cMaxMoves = pml->cMaxPips = pml->iMoveBest = 0;
     pml->amMoves = MT_Get_aMoves();
-    GenerateMovesSub(pml, anRoll, 0, 23, 0, anBoard, anMoves, fPartial);
+    ResetMoveIndex();
+
+    ms.pml = pml;
+    ms.fPartial = fPartial;
+    GenerateMovesSub(anRoll, &key, fOcc, afOpen, fPartial, SaveMoves, &ms);
 
     if (anRoll[0] != anRoll[1]) {
         swap(anRoll, anRoll + 1);
 
-        GenerateMovesSub(pml, anRoll, 0, 23, 0, anBoard, anMoves, fPartial);
+        GenerateMovesSub(anRoll, &key, fOcc, afOpen, fPartial, SaveMoves, &ms);
     }
 
     return pml->cMoves;
 }
 
+/*
+ * GenerateMovesVisit() cannot drop a play once it has been passed on, so
+ * it makes two searches: the first one only finds how many chequers and
+ * pips a legal play moves (usually its first play already moves them all
+ * and ends it), the second one passes on the plays that move as many.
+ * The positions seen are still kept in the index, but only their keys
+ * are written.
+ */
+
+typedef struct {
+    unsigned int cMaxMoves, cMaxPips, cFull;
+    movelist ml;                /* the positions visited so far */
+    movevisitor pfVisit;
+    void *p;
+} movevisit;
+
+static int
+MaxMoves(void *p, unsigned int cMoves, unsigned int cPip, const int UNUSED(anMoves[]),
+         const positionkey *UNUSED(pkey))
+{
+    movevisit *const pmv = p;
+
+    if (cMoves > pmv->cMaxMoves || (cMoves == pmv->cMaxMoves && cPip > pmv->cMaxPips)) {
+        pmv->cMaxMoves = cMoves;
+        pmv->cMaxPips = cPip;
+    }
+
+    return cMoves == pmv->cFull;
+}
+
+static int
+VisitMove(void *p, unsigned int cMoves, unsigned int cPip, const int anMoves[], const positionkey *pkey)
+{
+    movevisit *const pmv = p;
+    move *pm;
+    int anMove[8];
+    unsigned int i;
+
+    if (cMoves != pmv->cMaxMoves || cPip != pmv->cMaxPips)
+        return 0;
+
+    if ((pm = IndexMove(&pmv->ml, pkey)) != pmv->ml.amMoves + pmv->ml.cMoves)
+        /* a duplicate */
+        return 0;
+
+    CopyKey(*pkey, pm->key);
+    pmv->ml.cMoves++;
+
+    for (i = 0; i < 8; i++)
+        anMove[i] = i < cMoves * 2 && anMoves[i] > -1 ? anMoves[i] : -1;
+
+    return pmv->pfVisit(pkey, anMove, pmv->p);
+}
+
+extern int
+GenerateMovesVisit(const TanBoard anBoard, int n0, int n1, movevisitor pfVisit, void *p)
+{
+    int anRoll[4];
+    positionkey key;
+    unsigned int afOpen[7], fOcc;
+    movevisit mv;
+
+    GenerateMovesInit(anBoard, n0, n1, anRoll, &key, &fOcc, afOpen);
+
+    mv.cMaxMoves = mv.cMaxPips = 0;
+    mv.cFull = n0 == n1 ? 4 : 2;
+    mv.ml.cMoves = 0;
+    mv.ml.amMoves = MT_Get_aMoves();
+    mv.pfVisit = pfVisit;
+    mv.p = p;
+
+    if (!GenerateMovesSub(anRoll, &key, fOcc, afOpen, FALSE, MaxMoves, &mv) && n0 != n1) {
+        swap(anRoll, anRoll + 1);
+        GenerateMovesSub(anRoll, &key, fOcc, afOpen, FALSE, MaxMoves, &mv);
+        swap(anRoll, anRoll + 1);
+    }
+
+    if (!mv.cMaxMoves)
+        /* no legal move */
+        return 0;
+
+    ResetMoveIndex();
+
+    if (!GenerateMovesSub(anRoll, &key, fOcc, afOpen, FALSE, VisitMove, &mv) && n0 != n1) {
+        swap(anRoll, anRoll + 1);
+        GenerateMovesSub(anRoll, &key, fOcc, afOpen, FALSE, VisitMove, &mv);
+    }
+
+    return (int)mv.ml.cMoves;
+}
+
 extern float
 KleinmanCount(int nPipOnRoll, int nPipNotOnRoll)
 {
@@ -2839,7 +3579,10 @@ StatusNeuralNet(neuralnet *pnn, char *szTitle, char *sz)
 {
     char buf[200];
     sz += sprintf(sz, " * %s %s:\n", szTitle, _("neural network evaluator"));
-    sprintf(buf, _("version %s, %u inputs, %u hidden units"), WEIGHTS_VERSION, pnn->cInput, pnn->cHidden);
+    sprintf(buf, _("version %s, %u inputs, %u hidden units, %s kernel"), WEIGHTS_VERSION, pnn->cInput, pnn->cHidden,
+            NeuralNetKernelName());
+    if (pnn->nQuant)
+        sprintf(strchr(buf, 0), _(", int%d weights"), pnn->nQuant);
     sprintf(sz, "   - %s.\n\n", buf);
 }
 
@@ -2963,50 +3706,279 @@ void CommandClearCache(char *UNUSED(sz))
     EvalCacheFlush();
 }
 
-extern double
-GetEvalCacheSize(void)
+/* The compact layout fits about four times as many entries as the full
+ * one in the same memory, and the sizes below are in full entries */
+#define CACHE_COMPACT_SHIFT 2
+
+extern double
+GetEvalCacheSize(void)
+{
+    if (cEval.size == 0)
+        return 0;
+    else {
+        double value = log(cEval.size) / log(2);
+        if (cEval.layout == CACHE_LAYOUT_COMPACT)
+            value -= CACHE_COMPACT_SHIFT;
+        if (value < 15)
+            return 0;
+        if (value < 17)
+            return .5; /* Special case for old default 65536 */
+        if (value >= CACHE_SIZE_GUIMAX)
+            return CACHE_SIZE_GUIMAX - 16; /* Maximum value */
+        else
+            return value - 16;
+    }
+}
+
+/* Empty cEval and give it cNew entries in another layout */
+static int
+EvalCacheCreate(unsigned int cNew, cachelayout layout)
+{
+    CacheDestroy(&cEval);
+    if (CacheCreate(&cEval, cNew, layout) != 0) {
+        cCache = 0;
+        return -1;
+    }
+
+    cCache = cEval.size;
+    return (int)cCache;
+}
+
+/* Give cEval 2^(size + 16) full entries of memory in the given layout,
+ * or none if size is 0.  Returns the new number of entries, or -1 */
+extern int
+SetEvalCacheSize(unsigned int size, cachelayout layout)
+{
+    unsigned int cNew;
+
+    if (size != 0 && layout == CACHE_LAYOUT_COMPACT)
+        size += CACHE_COMPACT_SHIFT;
+    cNew = (size == 0) ? 0 : 1U << (size + 16);
+
+    if (layout == cEval.layout)
+        return EvalCacheResize(cNew);
+
+    return EvalCacheCreate(cNew, layout);
+}
+
+extern unsigned int
+GetEvalCacheEntries(void)
+{
+    return cCache;
+}
+
+extern int
+GetCacheMB(int size)
+{
+    if (size <= 0)
+        return 0;
+    else if (cEval.layout == CACHE_LAYOUT_COMPACT)
+        return (1 << (size + 16)) * (int)sizeof(cacheLine) / (1024 * 1024);
+    else
+        return (1 << (size + 15)) * (int)sizeof(cacheNode) / (1024 * 1024);
+}
+
+extern int
+EvalCacheResize(unsigned int cNew)
+{
+    cCache = CacheResize(&cEval, cNew);
+    return cCache;
+}
+
+/* Switch cEval to another layout of about the same memory; the cache
+ * is emptied.  Returns the new number of entries, or -1 */
+extern int
+EvalCacheLayout(cachelayout layout)
+{
+    unsigned int cNew = cEval.size;
+
+    if (layout == cEval.layout)
+        return (int)cEval.size;
+
+    if (layout == CACHE_LAYOUT_COMPACT)
+        cNew <<= CACHE_COMPACT_SHIFT;
+    else
+        cNew >>= CACHE_COMPACT_SHIFT;
+
+    return EvalCacheCreate(cNew, layout);
+}
+
+extern void
+EvalCacheCounts(cachecounts *pcc, int fReset)
+{
+    MT_SumCacheCounts(pcc, fReset);
+}
+
+/*
+ * Files of EvalCacheSave(): a header of a whole NN_MAP_ALIGN section, then
+ * the tables of cEval and cpEval as they are in memory, each starting at
+ * a multiple of NN_MAP_ALIGN bytes.  They are only good for the same
+ * build, weights, quantization and bearoff databases, which the header
+ * records.
+ */
+#define EVAL_CACHE_MAGIC 0x43454247     /* "GBEC" */
+#define EVAL_CACHE_VERSION 1            /* change with the bits of EvalKey() */
+
+typedef struct {
+    unsigned int nMagic;        /* EVAL_CACHE_MAGIC */
+    unsigned int nVersion;      /* EVAL_CACHE_VERSION */
+    unsigned int nIdentity;     /* EvalIdentity() */
+    unsigned int cbNode;        /* sizeof(cacheNode) */
+    unsigned int cbLine;        /* sizeof(cacheLine) */
+    unsigned int anLayout[2];   /* cEval, cpEval */
+    unsigned int acEntries[2];
+} evalcachefile;
+
+static unsigned int
+HashWord(unsigned int nHash, unsigned int n)
 {
-    if (cEval.size == 0)
-        return 0;
-    else {
-        double value = log(cEval.size) / log(2);
-        if (value < 15)
-            return 0;
-        if (value < 17)
-            return .5; /* Special case for old default 65536 */
-        if (value >= CACHE_SIZE_GUIMAX)
-            return CACHE_SIZE_GUIMAX - 16; /* Maximum value */
-        else
-            return value - 16;
-    }
+    return (nHash ^ n) * 16777619u;
 }
 
-extern void
-SetEvalCacheSize(unsigned int size)
+/* Hash of everything besides the EvalKey() that an evaluation depends on */
+static unsigned int
+EvalIdentity(void)
 {
-    EvalCacheResize((size == 0) ? 0 : 1U << (size + 16));
+    neuralnet *apnn[] = {&nnContact, &nnRace, &nnCrashed, &nnpContact, &nnpCrashed, &nnpRace};
+    bearoffcontext *apbc[] = {pbc1, pbc2, pbcOS, pbcTS};
+    unsigned int nHash = 2166136261u;
+    const char *pch;
+    unsigned int i;
+
+    for (pch = WEIGHTS_VERSION; *pch; pch++)
+        nHash = HashWord(nHash, (unsigned char)*pch);
+    nHash = HashWord(nHash, (unsigned int)nNetQuant);
+
+    for (i = 0; i < sizeof(apnn) / sizeof(apnn[0]); i++)
+        nHash = NeuralNetHash(apnn[i], nHash);
+
+    /* the databases decide the class of a position and its evaluation */
+    for (i = 0; i < sizeof(apbc) / sizeof(apbc[0]); i++)
+        if (apbc[i]) {
+            nHash = HashWord(nHash, apbc[i]->bt + 1);
+            nHash = HashWord(nHash, apbc[i]->nPoints);
+            nHash = HashWord(nHash, apbc[i]->nChequers);
+            nHash = HashWord(nHash, (unsigned int)(apbc[i]->fGammon | apbc[i]->fND << 1 |
+                                                   apbc[i]->fHeuristic << 2 | apbc[i]->fCubeful << 3));
+        } else
+            nHash = HashWord(nHash, 0);
+
+    return nHash;
 }
 
-extern unsigned int
-GetEvalCacheEntries(void)
+/* Move pf to the next multiple of NN_MAP_ALIGN, writing zeros if fWrite */
+static int
+AlignFile(FILE *pf, int fWrite)
 {
-    return cCache;
+    static const char achZero[NN_MAP_ALIGN];
+    long const n = ftell(pf);
+    size_t const cb = n < 0 ? 0 : (NN_MAP_ALIGN - n % NN_MAP_ALIGN) % NN_MAP_ALIGN;
+
+    if (n < 0)
+        return -1;
+
+    if (fWrite)
+        return fwrite(achZero, 1, cb, pf) < cb ? -1 : 0;
+    else
+        return fseek(pf, (long)cb, SEEK_CUR);
 }
 
+/* Save cEval and cpEval to szFile; no evaluation may run meanwhile */
 extern int
-GetCacheMB(int size)
+EvalCacheSave(const char *szFile)
+{
+    char ach[NN_MAP_ALIGN] = {0};
+    evalcachefile *pecf = (evalcachefile *)ach;
+    FILE *pf;
+    int f;
+
+    pecf->nMagic = EVAL_CACHE_MAGIC;
+    pecf->nVersion = EVAL_CACHE_VERSION;
+    pecf->nIdentity = EvalIdentity();
+    pecf->cbNode = sizeof(cacheNode);
+    pecf->cbLine = sizeof(cacheLine);
+    pecf->anLayout[0] = cEval.layout;
+    pecf->anLayout[1] = cpEval.layout;
+    pecf->acEntries[0] = cEval.size;
+    pecf->acEntries[1] = cpEval.size;
+
+    if ((pf = g_fopen(szFile, "wb")) == NULL)
+        return -1;
+
+    f = fwrite(ach, 1, sizeof(ach), pf) < sizeof(ach) ||
+        CacheWrite(&cEval, pf) || AlignFile(pf, TRUE) || CacheWrite(&cpEval, pf);
+
+    if (fclose(pf))
+        f = TRUE;
+
+    return f ? -1 : 0;
+}
+
+/* Give pc the layout and size of a saved cache and read its table */
+static int
+LoadCache(evalCache *pc, unsigned int nLayout, unsigned int cEntries, FILE *pf)
 {
-    if (size <= 0)
-        return 0;
-    else
-        return (1 << (size + 15)) * (int)sizeof(cacheNode) / (1024 * 1024);
+    if (nLayout != pc->layout) {
+        CacheDestroy(pc);
+        if (CacheCreate(pc, cEntries, (cachelayout)nLayout))
+            return -1;
+    } else if (CacheResize(pc, cEntries) < 0)
+        return -1;
+
+    /* CacheCreate() rounds up to a power of 2 */
+    if (pc->size != cEntries) {
+        CacheFlush(pc);
+        errno = EINVAL;
+        return -1;
+    }
+
+    return CacheRead(pc, pf);
 }
 
+/* Load the caches saved by EvalCacheSave() to szFile; they take the
+ * layout and size they had then.  A file from other weights, bearoff
+ * databases or build is refused and leaves the caches alone; a file
+ * that fails to read leaves them empty. */
 extern int
-EvalCacheResize(unsigned int cNew)
+EvalCacheLoad(const char *szFile)
 {
-    cCache = CacheResize(&cEval, cNew);
-    return cCache;
+    char ach[NN_MAP_ALIGN];
+    evalcachefile *pecf = (evalcachefile *)ach;
+    FILE *pf;
+    int i, f;
+
+    if ((pf = g_fopen(szFile, "rb")) == NULL)
+        return -1;
+
+    if (fread(ach, 1, sizeof(ach), pf) < sizeof(ach) ||
+        pecf->nMagic != EVAL_CACHE_MAGIC || pecf->nVersion != EVAL_CACHE_VERSION ||
+        pecf->nIdentity != EvalIdentity() || pecf->cbNode != sizeof(cacheNode) || pecf->cbLine != sizeof(cacheLine)) {
+        fclose(pf);
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0; i < 2; i++)
+        if (pecf->anLayout[i] > CACHE_LAYOUT_COMPACT || pecf->acEntries[i] > 1u << 31) {
+            fclose(pf);
+            errno = EINVAL;
+            return -1;
+        }
+
+    f = LoadCache(&cEval, pecf->anLayout[0], pecf->acEntries[0], pf) ||
+        AlignFile(pf, FALSE) || LoadCache(&cpEval, pecf->anLayout[1], pecf->acEntries[1], pf);
+
+    if (f) {
+        CacheFlush(&cEval);
+        CacheFlush(&cpEval);
+        if (!ferror(pf))
+            errno = EINVAL;     /* short file */
+    }
+    cCache = cEval.size;
+
+    fclose(pf);
+
+    return f ? -1 : 0;
 }
 
 #if CACHE_STATS
@@ -3919,6 +4891,11 @@ cmp_evalcontext(const evalcontext *pec1, const evalcontext *pec2)
             return +1;
     }
 
+    if (pec1->fBearoffPlay > pec2->fBearoffPlay)
+        return -1;
+    else if (pec1->fBearoffPlay < pec2->fBearoffPlay)
+        return +1;
+
     return 0;
 }
 
@@ -4799,13 +5776,228 @@ static int ScoreMovesPruned(movelist *pml, const cubeinfo *pci, const evalcontex
 #define MIN_PRUNE_MOVES 5
 #define MAX_PRUNE_MOVES (MIN_PRUNE_MOVES + 11)
 
+/*
+ * Batched 0-ply evaluation of move lists.
+ *
+ * The positions after each move are collected in groups of up to
+ * NN_BATCH_SIZE positions of the same class and evaluated with a single
+ * call to the net, so the weights of the net are read
+ * once per group rather than once per move.  The results are stored in
+ * the cache under the key a plain evaluation would use, so callers find
+ * them there as usual.
+ */
+#define NN_BATCH_SIZE 32
+
+typedef struct {
+    evalCache *pcache;
+    int fPrune;                 /* use the pruning nets and inputs */
+    bgvariation bgv;
+    const cubeinfo *pci;        /* for the scores of apm[] */
+    const neuralnet *pnn;
+    positionclass pc;
+    unsigned int c;
+    TanBoard aanBoard[NN_BATCH_SIZE];
+    evalcache aec[NN_BATCH_SIZE];
+    uint32_t al[NN_BATCH_SIZE];
+    move *apm[NN_BATCH_SIZE];
+    union {
+        SSE_ALIGN(float aarInput[NN_BATCH_SIZE * NUM_INPUTS]);
+        nninput aanRace[NN_BATCH_SIZE * MAX_RACE_ACTIVE];       /* for the race net */
+    };
+    unsigned int acRace[NN_BATCH_SIZE];
+} nnbatch;
+
+static void
+FlushBatch(nnbatch *pb)
+{
+    SSE_ALIGN(float aarOutput[NN_BATCH_SIZE * NUM_OUTPUTS]);
+    unsigned int k;
+
+    if (pb->c == 0)
+        return;
+
+    /* each position from scratch, as EvaluatePosition() would: an entry
+     * of the cache must not depend on the moves evaluated with it */
+    if (pb->fPrune || pb->pc != CLASS_RACE)
+        NeuralNetEvaluateBoard(pb->pnn, pb->c, (const TanBoard *)pb->aanBoard, pb->aarInput, aarOutput);
+    else
+        NeuralNetEvaluateSparse(pb->pnn, pb->c, pb->aanRace, MAX_RACE_ACTIVE, pb->acRace, aarOutput);
+
+    for (k = 0; k < pb->c; k++) {
+        float *arOutput = aarOutput + k * NUM_OUTPUTS;
+
+        if (pb->pc == CLASS_RACE)
+            /* special evaluation of backgammons overrides net output */
+            EvalRaceBG((ConstTanBoard)pb->aanBoard[k], arOutput, pb->bgv);
+
+        SanityCheck((ConstTanBoard)pb->aanBoard[k], arOutput);
+
+        memcpy(pb->aec[k].ar, arOutput, sizeof(float) * NUM_OUTPUTS);
+        pb->aec[k].ar[5] = 0.f;
+        CountAdd(pb->pcache, pb->pc, pb->aec[k].nEvalContext, CacheAdd(pb->pcache, &pb->aec[k], pb->al[k]));
+
+        if (pb->apm[k])
+            pb->apm[k]->rScore = UtilityME(arOutput, pb->pci);
+    }
+
+    pb->c = 0;
+}
+
+static void
+BatchAdd(nnbatch *pb, const TanBoard anBoard, positionclass pc, const evalcache *pec, uint32_t l, move *pm)
+{
+    static const neuralnet *const apnn[] = {&nnRace, &nnCrashed, &nnContact};
+    static const neuralnet *const apnnPrune[] = {&nnpRace, &nnpCrashed, &nnpContact};
+    float *arInput;
+
+    if (pb->c && pb->pc != pc)
+        FlushBatch(pb);
+
+    if (pb->c == 0) {
+        pb->pc = pc;
+        pb->pnn = pb->fPrune ? apnnPrune[pc - CLASS_RACE] : apnn[pc - CLASS_RACE];
+    }
+
+    arInput = pb->aarInput + pb->c * pb->pnn->cInput;
+
+    /* the board inputs come from the net tables, see FlushBatch(); the
+     * others start from those of the previous position, usually the
+     * previous move of the same list */
+    if (!pb->fPrune) {
+        ConstTanBoard anBoardPrev = pb->c ? (ConstTanBoard)pb->aanBoard[pb->c - 1] : NULL;
+        const float *arInputPrev = pb->c ? arInput - pb->pnn->cInput : NULL;
+
+        if (pc == CLASS_RACE)
+            pb->acRace[pb->c] = CalculateRaceActive(anBoard, pb->aanRace + pb->c * MAX_RACE_ACTIVE);
+        else if (pc == CLASS_CRASHED)
+            CalculateCrashedMoreInputs(anBoard, arInput, anBoardPrev, arInputPrev);
+        else
+            CalculateContactMoreInputs(anBoard, arInput, anBoardPrev, arInputPrev);
+    }
+
+    memcpy(pb->aanBoard[pb->c], anBoard, sizeof(TanBoard));
+    pb->aec[pb->c] = *pec;
+    pb->al[pb->c] = l;
+    pb->apm[pb->c] = pm;
+
+    if (++pb->c == NN_BATCH_SIZE)
+        FlushBatch(pb);
+}
+
+/* Make sure the cache holds the 0-ply evaluations that ScoreMove() will
+ * need for the moves ai[0..c-1] of pml (all of them if ai is NULL) */
+static void
+EvaluateMovesBatch(const movelist *pml, const unsigned int *ai, unsigned int c,
+                   const cubeinfo *pci, const evalcontext *pec)
+{
+    /* one batch per class, so that a list mixing classes (a move that
+     * breaks contact, say) does not cut the batches short */
+    nnbatch ab[N_CLASSES - CLASS_RACE];
+    cubeinfo ci;
+    unsigned int j;
+    int nContext;
+
+    if (!cCache || pec->rNoise != 0.0f)
+        return;
+
+    /* ScoreMove() evaluates from the opponent's point of view; cubeful
+     * evaluations end up in EvaluatePosition() with ecBasic */
+    memcpy(&ci, pci, sizeof(ci));
+    ci.fMove = !ci.fMove;
+    nContext = EvalKey(pec->fCubeful ? &ecBasic : pec, 0, &ci, FALSE);
+
+    for (j = 0; j < N_CLASSES - CLASS_RACE; j++) {
+        ab[j].pcache = &cEval;
+        ab[j].fPrune = FALSE;
+        ab[j].bgv = pci->bgv;
+        ab[j].pci = NULL;
+        ab[j].c = 0;
+    }
+
+    for (j = 0; j < c; j++) {
+        const move *pm = pml->amMoves + (ai ? ai[j] : j);
+        TanBoard anBoard;
+        positionclass pc;
+        evalcache ec;
+        uint32_t l;
+        float arOutput[NUM_OUTPUTS];
+
+        PositionFromKeySwapped(anBoard, &pm->key);
+
+        pc = ClassifyPosition((ConstTanBoard)anBoard, pci->bgv);
+        if (pc < CLASS_RACE)
+            continue;
+
+        PositionKey((ConstTanBoard)anBoard, &ec.key);
+        ec.nEvalContext = nContext;
+        l = CacheLookup(&cEval, &ec, arOutput, NULL);
+        CountLookup(&cEval, pc, nContext, l == CACHEHIT);
+        if (l != CACHEHIT)
+            BatchAdd(ab + pc - CLASS_RACE, (ConstTanBoard)anBoard, pc, &ec, l, NULL);
+    }
+
+    for (j = 0; j < N_CLASSES - CLASS_RACE; j++)
+        FlushBatch(ab + j);
+}
+
+/* Score the moves of pml with the pruning nets, from the point of view
+ * of pci (the player on roll after the move).  All the positions must be
+ * of the same class: return the index of the first one that is not, or
+ * pml->cMoves if all of them have been scored. */
+static unsigned int
+ScoreMovesPruning(movelist *pml, const cubeinfo *pci)
+{
+    nnbatch b;
+    positionclass evalClass = CLASS_OVER;
+    unsigned int i;
+
+    b.pcache = &cpEval;
+    b.fPrune = TRUE;
+    b.bgv = VARIATION_STANDARD;
+    b.pci = pci;
+    b.c = 0;
+
+    for (i = 0; i < pml->cMoves; i++) {
+        move *const pm = &pml->amMoves[i];
+        TanBoard anBoard;
+        positionclass pc;
+        evalcache ec;
+        uint32_t l;
+        SSE_ALIGN(float arOutput[NUM_OUTPUTS]);
+
+        PositionFromKeySwapped(anBoard, &pm->key);
+
+        pc = ClassifyPosition((ConstTanBoard)anBoard, VARIATION_STANDARD);
+        if (i == 0) {
+            if (pc < CLASS_RACE)
+                break;
+            evalClass = pc;
+        } else if (pc != evalClass)
+            break;
+
+        CopyKey(pm->key, ec.key);
+        ec.nEvalContext = 0;
+        l = CacheLookup(&cpEval, &ec, arOutput, NULL);
+        CountLookup(&cpEval, pc, 0, l == CACHEHIT);
+        if (l != CACHEHIT)
+            BatchAdd(&b, (ConstTanBoard)anBoard, pc, &ec, l, pm);
+        else
+            pm->rScore = UtilityME(arOutput, pci);
+    }
+
+    /* the scores are of no use unless all the moves have one */
+    if (i == pml->cMoves)
+        FlushBatch(&b);
+
+    return i;
+}
+
 static SIMD_AVX_STACKALIGN void
-FindBestMoveInEval(NNState *nnStates, int const nDice0, int const nDice1, const TanBoard anBoardIn,
+FindBestMoveInEval(int const nDice0, int const nDice1, const TanBoard anBoardIn,
                    TanBoard anBoardOut, cubeinfo *const pci, const evalcontext *pec)
 {
     unsigned int i;
     movelist ml;
-    positionclass evalClass = CLASS_OVER;
     unsigned int bmovesi[MAX_PRUNE_MOVES];
     unsigned int prune_moves;
 
@@ -4832,54 +6024,19 @@ FindBestMoveInEval(NNState *nnStates, int const nDice0, int const nDice1, const
         return;
     }
 
+    pci->fMove = !pci->fMove;
+    i = ScoreMovesPruning(&ml, pci);
     pci->fMove = !pci->fMove;
 
-    for (i = 0; i < ml.cMoves; i++) {
-        positionclass pc;
-        SSE_ALIGN(float arOutput[NUM_OUTPUTS]);
-        evalcache ec;
-        uint32_t l;
-        move *const pm = &ml.amMoves[i];
-
-        PositionFromKeySwapped(anBoardOut, &pm->key);
-
-        pc = ClassifyPosition((ConstTanBoard)anBoardOut, VARIATION_STANDARD);
-        if (i == 0) {
-            if (pc < CLASS_RACE)
-                break;
-            evalClass = pc;
-        } else if (pc != evalClass)
-            break;
+    if (i < ml.cMoves) {
+        ScoreMoves(&ml, pci, pec, 0);
+        PositionFromKey(anBoardOut, &ml.amMoves[ml.iMoveBest].key);
+        return;
+    }
 
-        CopyKey(pm->key, ec.key);
-        ec.nEvalContext = 0;
-        if ((l = CacheLookup(&cpEval, &ec, arOutput, NULL)) != CACHEHIT) {
-            SSE_ALIGN(float arInput[NUM_PRUNING_INPUTS]);
-
-            baseInputs((ConstTanBoard)anBoardOut, arInput);
-            {
-                const neuralnet *nets[] = {&nnpRace, &nnpCrashed, &nnpContact};
-                const neuralnet *n = nets[pc - CLASS_RACE];
-#if defined(USE_SIMD_INSTRUCTIONS)
-                (void)nnStates; /* silence compiler warning */
-                NeuralNetEvaluateSSE(n, arInput, arOutput, NULL);
-#else
-                if (nnStates)
-                    nnStates[pc - CLASS_RACE].state = (i == 0) ? NNSTATE_INCREMENTAL : NNSTATE_DONE;
-                NeuralNetEvaluate(n, arInput, arOutput, nnStates);
-#endif
-                if (pc == CLASS_RACE)
-                    /* special evaluation of backgammons
-                     * overrides net output */
-                    EvalRaceBG((ConstTanBoard)anBoardOut, arOutput, VARIATION_STANDARD);
+    for (i = 0; i < ml.cMoves; i++) {
+        const move *const pm = &ml.amMoves[i];
 
-                SanityCheck((ConstTanBoard)anBoardOut, arOutput);
-            }
-            memcpy(ec.ar, arOutput, sizeof(float) * NUM_OUTPUTS);
-            ec.ar[5] = 0.f;
-            CacheAdd(&cpEval, &ec, l);
-        }
-        pm->rScore = UtilityME(arOutput, pci);
         if (i < prune_moves) {
             bmovesi[i] = i;
             if (pm->rScore > ml.amMoves[bmovesi[0]].rScore) {
@@ -4899,16 +6056,44 @@ FindBestMoveInEval(NNState *nnStates, int const nDice0, int const nDice1, const
         }
     }
 
-    pci->fMove = !pci->fMove;
-
-    if (i == ml.cMoves)
-        ScoreMovesPruned(&ml, pci, pec, bmovesi, prune_moves);
-    else
-        ScoreMoves(&ml, pci, pec, 0);
+    ScoreMovesPruned(&ml, pci, pec, bmovesi, prune_moves);
 
     PositionFromKey(anBoardOut, &ml.amMoves[ml.iMoveBest].key);
 }
 
+/*
+ * Different rolls often lead to the same position (dancing, primes,
+ * bearoffs), so a chance node evaluates each distinct child once; the
+ * children are still summed in the order of the rolls, which keeps the
+ * result the same to the last bit.  Not with random noise, where each
+ * roll has its own.
+ */
+static unsigned int cChanceChildren, cChanceMerged;
+
+/* Return the first of the akey[0..k-1] that is the same as akey[k], or k */
+static int
+ChanceChild(const positionkey akey[], int k)
+{
+    int j;
+
+    cChanceChildren++;
+
+    for (j = 0; j < k; j++)
+        if (EqualKeys(akey[j], akey[k])) {
+            cChanceMerged++;
+            break;
+        }
+
+    return j;
+}
+
+extern void
+EvalChanceStats(unsigned int *pcChildren, unsigned int *pcMerged)
+{
+    *pcChildren = cChanceChildren;
+    *pcMerged = cChanceMerged;
+}
+
 static int
 EvaluatePositionFull(NNState *nnStates, const TanBoard anBoard, float arOutput[],
                      cubeinfo *const pci, const evalcontext *pec, unsigned int nPlies, positionclass pc)
@@ -4923,9 +6108,12 @@ EvaluatePositionFull(NNState *nnStates, const TanBoard anBoard, float arOutput[]
         /* int anMove[ 8 ]; */
         cubeinfo ciOpp;
         float rTemp;
-        int n0, n1;
+        int n0, n1, k = 0, j;
+        positionkey akey[21];
+        float aar[21][NUM_OUTPUTS];
 
         int const usePrune = pec->fUsePrune && pec->rNoise == 0.0f && pci->bgv == VARIATION_STANDARD;
+        int const fMerge = pec->rNoise == 0.0f || pec->fDeterministic;
 
         for (i = 0; i < NUM_OUTPUTS; i++)
             arOutput[i] = 0.0;
@@ -4947,7 +6135,7 @@ EvaluatePositionFull(NNState *nnStates, const TanBoard anBoard, float arOutput[]
                 }
 
                 if (usePrune) {
-                    FindBestMoveInEval(nnStates, n0, n1, anBoard, anBoardNew, pci, pec);
+                    FindBestMoveInEval(n0, n1, anBoard, anBoardNew, pci, pec);
                 } else {
 
                     FindBestMovePlied(NULL, n0, n1, anBoardNew, pci, pec, 0, defaultFilters);
@@ -4955,17 +6143,27 @@ EvaluatePositionFull(NNState *nnStates, const TanBoard anBoard, float arOutput[]
 
                 SwapSides(anBoardNew);
 
-                SetCubeInfo(&ciOpp, pci->nCube, pci->fCubeOwner, !pci->fMove,
-                            pci->nMatchTo, pci->anScore, pci->fCrawford, pci->fJacoby, pci->fBeavers, pci->bgv);
+                PositionKey((ConstTanBoard)anBoardNew, &akey[k]);
 
-                /* Evaluate at 0-ply */
-                if (EvaluatePositionCache(nnStates, (ConstTanBoard)anBoardNew, arVariationOutput,
-                                          &ciOpp, pec, nPlies - 1,
-                                          ClassifyPosition((ConstTanBoard)anBoardNew, ciOpp.bgv)))
-                    return -1;
+                if (fMerge && (j = ChanceChild(akey, k)) < k)
+                    memcpy(aar[k], aar[j], sizeof(aar[k]));
+                else {
+                    SetCubeInfo(&ciOpp, pci->nCube, pci->fCubeOwner, !pci->fMove,
+                                pci->nMatchTo, pci->anScore, pci->fCrawford, pci->fJacoby, pci->fBeavers, pci->bgv);
+
+                    /* Evaluate at 0-ply */
+                    if (EvaluatePositionCache(nnStates, (ConstTanBoard)anBoardNew, arVariationOutput,
+                                              &ciOpp, pec, nPlies - 1,
+                                              ClassifyPosition((ConstTanBoard)anBoardNew, ciOpp.bgv)))
+                        return -1;
+
+                    memcpy(aar[k], arVariationOutput, sizeof(aar[k]));
+                }
 
                 for (i = 0; i < NUM_OUTPUTS; i++)
-                    arOutput[i] += w * arVariationOutput[i];
+                    arOutput[i] += w * aar[k][i];
+
+                k++;
             }
         }
 
@@ -5022,7 +6220,9 @@ EvaluatePositionCache(NNState *nnStates, const TanBoard anBoard, float arOutput[
     PositionKey(anBoard, &ec.key);
 
     ec.nEvalContext = EvalKey(pecx, nPlies, pci, FALSE);
-    if ((l = CacheLookup(&cEval, &ec, arOutput, NULL)) == CACHEHIT) {
+    l = CacheLookup(&cEval, &ec, arOutput, NULL);
+    CountLookup(&cEval, pc, ec.nEvalContext, l == CACHEHIT);
+    if (l == CACHEHIT) {
         return 0;
     }
 
@@ -5031,7 +6231,7 @@ EvaluatePositionCache(NNState *nnStates, const TanBoard anBoard, float arOutput[
 
     memcpy(ec.ar, arOutput, sizeof(float) * NUM_OUTPUTS);
     ec.ar[5] = 0.f;
-    CacheAdd(&cEval, &ec, l);
+    CountAdd(&cEval, pc, ec.nEvalContext, CacheAdd(&cEval, &ec, l));
     return 0;
 }
 
@@ -5069,9 +6269,9 @@ ScoreMove(NNState *nnStates, move *pm, const cubeinfo *pci, const evalcontext *p
     memcpy(pm->arEvalMove, arEval, NUM_ROLLOUT_OUTPUTS * sizeof(float));
 
     /* Save evaluation setup */
-    pm->esMove.et = EVAL_EVAL;
-    pm->esMove.ec = *pec;
-    pm->esMove.ec.nPlies = nPlies;
+    pm->etMove = EVAL_EVAL;
+    pm->ecMove = *pec;
+    pm->ecMove.nPlies = nPlies;
 
     /* Score for move:
      * rScore is the primary score (cubeful/cubeless)
@@ -5091,10 +6291,10 @@ ScoreMoves(movelist *pml, const cubeinfo *pci, const evalcontext *pec, int nPlie
 
     pml->rBestScore = -99999.9f;
 
-    if (nPlies == 0) {
-        /* start incremental evaluations */
-        nnStates[0].state = nnStates[1].state = nnStates[2].state = NNSTATE_INCREMENTAL;
-    }
+    /* no incremental evaluations: their rounding differs from that of
+     * the batch, and both store in the same entries of the cache */
+    if (nPlies == 0)
+        EvaluateMovesBatch(pml, NULL, pml->cMoves, pci, pec);
 
     for (i = 0; i < pml->cMoves; i++) {
         if (ScoreMove(nnStates, pml->amMoves + i, pci, pec, nPlies) < 0) {
@@ -5109,12 +6309,6 @@ ScoreMoves(movelist *pml, const cubeinfo *pci, const evalcontext *pec, int nPlie
         }
     }
 
-    if (nPlies == 0) {
-        /* reset to none */
-
-        nnStates[0].state = nnStates[1].state = nnStates[2].state = NNSTATE_NONE;
-    }
-
     return r;
 }
 
@@ -5128,8 +6322,7 @@ ScoreMovesPruned(movelist *pml, const cubeinfo *pci, const evalcontext *pec, uns
 
     pml->rBestScore = -99999.9f;
 
-    /* start incremental evaluations */
-    nnStates[0].state = nnStates[1].state = nnStates[2].state = NNSTATE_INCREMENTAL;
+    EvaluateMovesBatch(pml, bmovesi, prune_moves, pci, pec);
 
     for (j = 0; j < prune_moves; j++) {
 
@@ -5147,13 +6340,86 @@ ScoreMovesPruned(movelist *pml, const cubeinfo *pci, const evalcontext *pec, uns
         }
     }
 
-    nnStates[0].state = nnStates[1].state = nnStates[2].state = NNSTATE_NONE;
-
     return r;
 }
 
 static movefilter NullFilter = {-1, 0, 0.0};
 
+extern int
+EvalBearoffPlays(int fUse)
+{
+    if (!fUse) {
+        free(ausBearoffPlay);
+        ausBearoffPlay = NULL;
+        return 0;
+    }
+
+    if (!ausBearoffPlay && pbc1)
+        ausBearoffPlay = BearoffPlays(pbc1);
+
+    return ausBearoffPlay ? 0 : -1;
+}
+
+typedef struct {
+    unsigned int iPos;          /* bearoff index of the position to play to */
+    int *anMove;
+    int fFound;
+} bearoffvisit;
+
+static int
+VisitBearoffPlay(const positionkey *pkey, const int anMove[8], void *p)
+{
+    bearoffvisit *const pbv = p;
+    TanBoard anBoard;
+
+    PositionFromKey(anBoard, pkey);
+    if (PositionBearoff(anBoard[1], pbc1->nPoints, pbc1->nChequers) != pbv->iPos)
+        return 0;
+
+    memcpy(pbv->anMove, anMove, 8 * sizeof(int));
+    pbv->fFound = TRUE;
+
+    return 1;
+}
+
+/*
+ * Play the move of ausBearoffPlay[] in a CLASS_BEAROFF1 position where
+ * neither side can lose a gammon any more, so that only the race to bear
+ * off matters.  Return -1 if the table does not apply.
+ */
+static int
+FindBearoffPlay(int anMove[8], int nDice0, int nDice1, TanBoard anBoard)
+{
+    bearoffvisit bv;
+    int an[8];
+    unsigned int i, nOpp = 0, nMe = 0;
+    int const n0 = MAX(nDice0, nDice1), n1 = MIN(nDice0, nDice1);
+
+    for (i = 0; i < 6; i++) {
+        nOpp += anBoard[0][i];
+        nMe += anBoard[1][i];
+    }
+    if (nOpp == 15 || nMe == 15)
+        return -1;
+
+    bv.iPos = ausBearoffPlay[PositionBearoff(anBoard[1], pbc1->nPoints, pbc1->nChequers) * 21 + BEAROFF_ROLL(n0, n1)];
+    bv.anMove = an;
+    bv.fFound = FALSE;
+
+    GenerateMovesVisit((ConstTanBoard)anBoard, nDice0, nDice1, VisitBearoffPlay, &bv);
+
+    if (!bv.fFound)
+        return -1;
+
+    if (anMove)
+        memcpy(anMove, an, sizeof(an));
+    ApplyMove(anBoard, an, FALSE);
+
+    for (i = 0; i < 8 && an[i] >= 0; i++);
+
+    return (int)i;
+}
+
 static int
 FindBestMovePlied(int anMove[8], int nDice0, int nDice1,
                   TanBoard anBoard,
@@ -5164,6 +6430,7 @@ FindBestMovePlied(int anMove[8], int nDice0, int nDice1,
     evalcontext ec;
     movelist ml;
     unsigned int i;
+    int n;
 
     memcpy(&ec, pec, sizeof(evalcontext));
     ec.nPlies = nPlies;
@@ -5172,6 +6439,11 @@ FindBestMovePlied(int anMove[8], int nDice0, int nDice1,
         for (i = 0; i < 8; ++i)
             anMove[i] = -1;
 
+    if (pec->fBearoffPlay && ausBearoffPlay && nPlies == 0 &&
+        ClassifyPosition((ConstTanBoard)anBoard, pci->bgv) == CLASS_BEAROFF1 &&
+        (n = FindBearoffPlay(anMove, nDice0, nDice1, anBoard)) >= 0)
+        return n;
+
     if (FindnSaveBestMoves(&ml, nDice0, nDice1, (ConstTanBoard)anBoard, NULL, 0.0f, pci, &ec, aamf) < 0) {
         g_free(ml.amMoves);
         return -1;
@@ -5310,7 +6582,7 @@ finished:
 
                 /* ensure top move is evaluted at deepest ply */
 
-                if (pml->amMoves[i].esMove.ec.nPlies < nMaxPly) {
+                if (pml->amMoves[i].ecMove.nPlies < nMaxPly) {
                     ScoreMove(NULL, pml->amMoves + i, pci, pec, nMaxPly);
                     fResort = TRUE;
                 }
@@ -5467,10 +6739,14 @@ EvaluatePositionCubeful4(NNState *nnStates, const TanBoard anBoard,
         /* internal node; recurse */
 
         TanBoard anBoardNew;
-        int n0, n1;
+        int n0, n1, k = 0, j;
         float r;
+        positionkey akey[21];
+        float aar[21][NUM_OUTPUTS];
+        float *aarCf = (float *)g_alloca(21 * 2 * cci * sizeof(float));
 
         int const usePrune = pec->fUsePrune && pec->rNoise == 0.0f && pciMove->bgv == VARIATION_STANDARD;
+        int const fMerge = pec->rNoise == 0.0f || pec->fDeterministic;
 
         for (i = 0; i < NUM_OUTPUTS; i++)
             arOutput[i] = 0.0;
@@ -5499,7 +6775,7 @@ EvaluatePositionCubeful4(NNState *nnStates, const TanBoard anBoard,
                 }
 
                 if (usePrune) {
-                    FindBestMoveInEval(nnStates, n0, n1, anBoard, anBoardNew, pciMove, pec);
+                    FindBestMoveInEval(n0, n1, anBoard, anBoardNew, pciMove, pec);
                 } else {
 
                     FindBestMovePlied(NULL, n0, n1, anBoardNew, pciMove, pec, 0, defaultFilters);
@@ -5507,22 +6783,35 @@ EvaluatePositionCubeful4(NNState *nnStates, const TanBoard anBoard,
 
                 SwapSides(anBoardNew);
 
-                SetCubeInfo(&ciMoveOpp,
-                            pciMove->nCube, pciMove->fCubeOwner,
-                            !pciMove->fMove, pciMove->nMatchTo,
-                            pciMove->anScore, pciMove->fCrawford, pciMove->fJacoby, pciMove->fBeavers, pciMove->bgv);
+                PositionKey((ConstTanBoard)anBoardNew, &akey[k]);
 
-                /* Evaluate at 0-ply */
-                if (EvaluatePositionCubeful3(nnStates, (ConstTanBoard)anBoardNew,
-                                             ar, arCfTemp, aci, 2 * cci, &ciMoveOpp, pec, nPlies - 1, FALSE))
-                    return -1;
+                if (fMerge && (j = ChanceChild(akey, k)) < k) {
+                    memcpy(aar[k], aar[j], sizeof(aar[k]));
+                    memcpy(aarCf + k * 2 * cci, aarCf + j * 2 * cci, 2 * cci * sizeof(float));
+                } else {
+                    SetCubeInfo(&ciMoveOpp,
+                                pciMove->nCube, pciMove->fCubeOwner,
+                                !pciMove->fMove, pciMove->nMatchTo,
+                                pciMove->anScore, pciMove->fCrawford, pciMove->fJacoby, pciMove->fBeavers,
+                                pciMove->bgv);
+
+                    /* Evaluate at 0-ply */
+                    if (EvaluatePositionCubeful3(nnStates, (ConstTanBoard)anBoardNew,
+                                                 ar, arCfTemp, aci, 2 * cci, &ciMoveOpp, pec, nPlies - 1, FALSE))
+                        return -1;
+
+                    memcpy(aar[k], ar, sizeof(aar[k]));
+                    memcpy(aarCf + k * 2 * cci, arCfTemp, 2 * cci * sizeof(float));
+                }
 
                 /* Sum up cubeless winning chances and cubeful equities */
 
                 for (i = 0; i < NUM_OUTPUTS; i++)
-                    arOutput[i] += w * ar[i];
+                    arOutput[i] += w * aar[k][i];
                 for (i = 0; i < 2 * cci; i++)
-                    arCf[i] += w * arCfTemp[i];
+                    arCf[i] += w * aarCf[k * 2 * cci + i];
+
+                k++;
             }
         }
 
@@ -5752,6 +7041,7 @@ EvaluatePositionCubeful3(NNState *nnStates, const TanBoard anBoard,
     int ici;
     int fAll;
     evalcache ec;
+    positionclass pc;
 
     if (!cCache || pec->rNoise != 0.0f)
     /* non-deterministic evaluation; never cache */
@@ -5761,6 +7051,8 @@ EvaluatePositionCubeful3(NNState *nnStates, const TanBoard anBoard,
     }
 
     PositionKey(anBoard, &ec.key);
+    /* for the counters; fTop positions are neither looked up nor added */
+    pc = fTop ? CLASS_OVER : ClassifyPosition(anBoard, aciCubePos[0].bgv);
 
     /* check cache for existence for earlier calculation */
 
@@ -5775,9 +7067,8 @@ EvaluatePositionCubeful3(NNState *nnStates, const TanBoard anBoard,
 
         ec.nEvalContext = EvalKey(pec, nPlies, &aciCubePos[ici], TRUE);
 
-        if (CacheLookup(&cEval, &ec, arOutput, arCubeful + ici) != CACHEHIT) {
-            fAll = FALSE;
-        }
+        fAll = CacheLookup(&cEval, &ec, arOutput, arCubeful + ici) == CACHEHIT;
+        CountLookup(&cEval, pc, ec.nEvalContext, fAll);
     }
 
     /* get equities */
@@ -5801,7 +7092,7 @@ EvaluatePositionCubeful3(NNState *nnStates, const TanBoard anBoard,
                 ec.ar[5] = arCubeful[ici]; /* Cubeful equity stored in slot 5 */
                 ec.nEvalContext = EvalKey(pec, nPlies, &aciCubePos[ici], TRUE);
 
-                CacheAdd(&cEval, &ec, GetHashKey(cEval.hashMask, &ec));
+                CountAdd(&cEval, pc, ec.nEvalContext, CacheAdd(&cEval, &ec, GetHashKey(cEval.hashMask, &ec)));
             }
         }
     }
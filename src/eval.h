@@ -33,6 +33,11 @@
 #define WEIGHTS_VERSION "1.01"
 #define WEIGHTS_VERSION_BINARY 1.01f
 #define WEIGHTS_MAGIC_BINARY 472.3782f
+/* Same weights, stored in the padded layout of the evaluator */
+#define WEIGHTS_MAGIC_BINARY_LAYOUT 472.3783f
+/* Same, with NN_MAP_ALIGN aligned sections and the board tables: the file
+ * is mapped and the nets point into it, see EvalInitialise() */
+#define WEIGHTS_MAGIC_BINARY_MAPPED 472.3784f
 
 #define NUM_OUTPUTS 5
 #define NUM_CUBEFUL_OUTPUTS 4
@@ -70,6 +75,21 @@ typedef enum {
 #define MAX_INCOMPLETE_MOVES 3875
 #define MAX_MOVES 3060
 
+/* Slots of the hash index of the moves being generated (see SaveMoves()),
+ * a power of 2 more than twice MAX_INCOMPLETE_MOVES */
+#define MOVE_INDEX_SIZE 8192
+
+/* The per-thread table of the race inputs of each side, see
+ * RaceHalfActive() */
+#define RACE_HALF_CACHE_BITS 10
+#define MAX_RACE_HALF_CACHED 16
+
+typedef struct {
+    uint32_t aKey[3];
+    unsigned int c;
+    nninput an[MAX_RACE_HALF_CACHED];   /* numbered from 0 */
+} racehalf;
+
 typedef struct {
     int Accept;      /* always allow this many moves.
                         0 means don't use this level,
@@ -89,7 +109,8 @@ typedef struct {
     unsigned int nPlies : 4;
     unsigned int fUsePrune : 1;
     unsigned int fDeterministic : 1;
-    unsigned int : 25; /* padding */
+    unsigned int fBearoffPlay : 1; /* 0-ply bearoff plays from EvalBearoffPlays() */
+    unsigned int : 24; /* padding */
     float rNoise;      /* standard deviation */
 } evalcontext;
 
@@ -219,11 +240,9 @@ typedef enum {
 
 extern evalcontext ecBasic;
 
-typedef enum {
-    CMARK_NONE,
-    CMARK_ROLLOUT
-} CMark;
-
+/* Move lists are generated, scored and sorted by the thousand, so a move
+ * only holds what that needs; a rollout keeps its settings and standard
+ * deviations in a separate moverollout (see ScoreMoveRollout()) */
 typedef struct {
     int anMove[8];
     positionkey key;
@@ -232,11 +251,15 @@ typedef struct {
     float rScore, rScore2;
     /* evaluation for this move */
     float arEvalMove[NUM_ROLLOUT_OUTPUTS];
-    float arEvalStdDev[NUM_ROLLOUT_OUTPUTS];
-    evalsetup esMove;
-    CMark cmark;
+    evaltype etMove;
+    evalcontext ecMove;         /* for EVAL_EVAL */
 } move;
 
+typedef struct {
+    evalsetup esMove;
+    float arEvalStdDev[NUM_ROLLOUT_OUTPUTS];
+} moverollout;
+
 extern int fInterrupt;
 
 extern bearoffcontext *pbc1;
@@ -298,7 +321,22 @@ extern classevalfunc acef[N_CLASSES];
 #define CFHYPER(arEquity, pci) \
     (((pci)->fCubeOwner == -1) ? (((pci)->fJacoby) ? arEquity[2] : arEquity[1]) : (((pci)->fCubeOwner == (pci)->fMove) ? arEquity[0] : arEquity[3]))
 
-extern void EvalInitialise(char *szWeights, char *szWeightsBinary, int fNoBearoff, void (*pfProgress)(unsigned int));
+extern void EvalInitialise(char *szWeights, char *szWeightsBinary, int fNoBearoff, int nQuantBits,
+                           void (*pfProgress)(unsigned int));
+
+/* Evaluate the nets with weights quantized to nBits (16 or 8), or with
+ * the float weights if nBits is 0 */
+extern int EvalSetQuantization(int nBits);
+
+extern int EvalGetQuantization(void);
+
+typedef struct {
+    unsigned int cPositions;
+    float rMax;  /* largest absolute cubeless equity error */
+    float rMean; /* mean absolute cubeless equity error */
+} quanterror;
+
+extern int EvalQuantizationError(int nBits, unsigned int cPositions, quanterror aqe[N_CLASSES]);
 
 extern int EvalShutdown(void);
 
@@ -308,6 +346,13 @@ extern int EvalNewWeights(int nSize);
 
 extern int EvalSave(const char *szWeights);
 
+/* Write the nets to a binary weights file, in the gnubg.wd format
+ * (NN_BINARY_DENSE) or in the layout of this build (NN_BINARY_LAYOUT),
+ * which loads without any conversion; NN_BINARY_MAPPED files are not
+ * even read, but mapped in memory and shared by all the processes that
+ * use them */
+extern int EvalSaveBinary(const char *szWeightsBinary, int nFormat);
+
 extern int
 EvaluatePosition(NNState *nnStates, const TanBoard anBoard, float arOutput[], cubeinfo *const pci, const evalcontext *pec);
 
@@ -350,9 +395,37 @@ GameStatus(const TanBoard anBoard, const bgvariation bgv);
 
 extern void EvalCacheFlush(void);
 extern int EvalCacheResize(unsigned int cNew);
+extern int EvalCacheLayout(cachelayout layout);
+extern int EvalCacheSave(const char *szFile);
+extern int EvalCacheLoad(const char *szFile);
 extern int EvalCacheStats(unsigned int *pcUsed, unsigned int *pcLookup, unsigned int *pcHit);
+
+/* Counters of cEval and cpEval, kept by each thread */
+typedef enum {
+    CACHE_COUNT_LOOKUP,
+    CACHE_COUNT_HIT,
+    CACHE_COUNT_COLLIDE,        /* added where another position was */
+    CACHE_COUNT_EVICT,          /* added and pushed an entry out */
+    N_CACHE_COUNTS
+} cachecount;
+
+#define CACHE_COUNT_PLIES 8     /* deeper evaluations count as the last */
+
+typedef struct {
+    unsigned long long aac[2][N_CLASSES][CACHE_COUNT_PLIES][N_CACHE_COUNTS]; /* cEval, cpEval */
+} cachecounts;
+
+/* The sum of the counters of all the threads; fReset zeroes them after */
+extern void EvalCacheCounts(cachecounts *pcc, int fReset);
+/* Children of the chance nodes of a search, and those that were the same
+ * position as an earlier roll and were not evaluated again */
+extern void EvalChanceStats(unsigned int *pcChildren, unsigned int *pcMerged);
+/* Build (fUse) or free the table of best plays of one-sided bearoff
+ * positions that evalcontexts with fBearoffPlay use; they score the
+ * moves as usual while there is none */
+extern int EvalBearoffPlays(int fUse);
 extern double GetEvalCacheSize(void);
-void SetEvalCacheSize(unsigned int size);
+extern int SetEvalCacheSize(unsigned int size, cachelayout layout);
 extern unsigned int GetEvalCacheEntries(void);
 extern int GetCacheMB(int size);
 
@@ -363,6 +436,17 @@ extern unsigned int cCache;
 extern int
 GenerateMoves(movelist *pml, const TanBoard anBoard, int n0, int n1, int fPartial);
 
+/* Called by GenerateMovesVisit() with each position a legal play leads
+ * to and the play (terminated by -1); return non-zero to stop */
+typedef int (*movevisitor) (const positionkey *pkey, const int anMove[8], void *p);
+
+/* Pass each position the legal plays of n0 and n1 lead to once to
+ * pfVisit, in the order of GenerateMoves(), without building the list;
+ * pfVisit must not generate moves itself.  Return the number of
+ * positions visited. */
+extern int
+GenerateMovesVisit(const TanBoard anBoard, int n0, int n1, movevisitor pfVisit, void *p);
+
 extern int ApplySubMove(TanBoard anBoard, const int iSrc, const int nRoll, const int fCheckLegal);
 
 extern int ApplyMove(TanBoard anBoard, const int anMove[8], const int fCheckLegal);
@@ -24,7 +24,10 @@
 #include "cache.h"
 #include "positionid.h"
 
-int CacheCreate(evalCache *pc, unsigned int s)
+/* Sequence counts shared by the lines of the compact layout, see below */
+#define CACHE_LINE_LOCKS 4096
+
+int CacheCreate(evalCache *pc, unsigned int s, cachelayout layout)
 {
     if (s > 1u << 31)
         return -1;
@@ -35,6 +38,33 @@ int CacheCreate(evalCache *pc, unsigned int s)
         s &= (s - 1);
 
     pc->size = (s < pc->size) ? 2 * s : s;
+    pc->layout = layout;
+    pc->entries = NULL;
+    pc->lines = NULL;
+    pc->anLineSeq = NULL;
+    atomic_init(&pc->cAdd, 0);
+    for (pc->nGenShift = 0; 2u << pc->nGenShift < pc->size; pc->nGenShift++);
+
+    if (layout == CACHE_LAYOUT_COMPACT) {
+        if (pc->size == 0)
+            return 0;
+        if (pc->size < CACHE_WAYS)
+            pc->size = CACHE_WAYS;
+        pc->hashMask = pc->size / CACHE_WAYS - 1;
+        pc->lines = aligned_alloc(sizeof(cacheLine), (pc->size / CACHE_WAYS) * sizeof(cacheLine));
+        pc->anLineSeq = malloc(CACHE_LINE_LOCKS * sizeof(*pc->anLineSeq));
+
+        if (pc->lines == NULL || pc->anLineSeq == NULL) {
+            CacheDestroy(pc);
+            pc->lines = NULL;
+            pc->anLineSeq = NULL;
+            return -1;
+        }
+
+        CacheFlush(pc);
+        return 0;
+    }
+
     pc->hashMask = (pc->size >> 1) - 1;
 
     void *mem = malloc((pc->size / 2) * sizeof(*pc->entries));
@@ -87,25 +117,279 @@ GetHashKey(uint32_t hashMask, const cacheNodeDetail *restrict e)
     return (hash & hashMask);
 }
 
+/*
+ * The WithLocking functions never wait.  The sequence count of a node
+ * (or of a line of the compact layout) is odd while a thread writes it
+ * and is advanced by each write, as in a seqlock: a lookup reads the
+ * count, compares and copies the entry, and reads the count again, and
+ * takes a write in progress or in between for a miss.  A thread that
+ * wants to write a node another thread is writing does not wait either,
+ * it leaves the node alone; a lost add or promotion only costs a later
+ * evaluation.
+ */
+
+/* Take the node or line of count *pnSeq for writing, FALSE if another
+ * thread has it */
+static inline int
+SeqWriteBegin(atomic_uint * pnSeq, unsigned int *pn)
+{
+    unsigned int nSeq = atomic_load_explicit(pnSeq, memory_order_relaxed);
+
+    if ((nSeq & 1) ||
+        !atomic_compare_exchange_strong_explicit(pnSeq, &nSeq, nSeq + 1, memory_order_relaxed,
+                                                 memory_order_relaxed))
+        return 0;
+
+    atomic_thread_fence(memory_order_release);
+    *pn = nSeq;
+
+    return 1;
+}
+
+static inline void
+SeqWriteEnd(atomic_uint * pnSeq, unsigned int nSeq)
+{
+    atomic_store_explicit(pnSeq, nSeq + 2, memory_order_release);
+}
+
+/*
+ * The compact layout keeps CACHE_WAYS entries of 16 bytes in each 64 byte
+ * line, most recently used first, so a lookup touches a single line of
+ * memory.  An entry holds the outputs as 16 bit fixed point, the
+ * probabilities scaled by 65535 and the cubeful equity in ar[5] by 8192,
+ * and a 32 bit fingerprint of key and context (bits of the hash that
+ * don't select the line) xor-ed with a mix of the outputs.
+ *
+ * The fingerprint is never 0, so a flushed entry never matches.  The
+ * WithLocking functions guard the lines with the sequence counts above,
+ * which are striped (line l has count l % CACHE_LINE_LOCKS) so that they
+ * don't make a line larger than 64 bytes; a lookup moves its hit to the
+ * front only if it can take the line and nobody wrote it since.
+ */
+
+#define COMPACT_EQUITY_SCALE 8192.0f
+
+static inline uint64_t
+CompactHash(const cacheNodeDetail *restrict e)
+{
+    uint64_t h = (uint32_t)e->nEvalContext * 0x9e3779b97f4a7c15ULL;
+    int i;
+
+    for (i = 0; i < 7; i++) {
+        h = (h ^ e->key.data[i]) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+static inline uint32_t
+CompactMix(const uint16_t aus[6])
+{
+    return ((aus[0] | (uint32_t)aus[1] << 16) * 0x9e3779b1u)
+        ^ ((aus[2] | (uint32_t)aus[3] << 16) * 0x85ebca6bu)
+        ^ ((aus[4] | (uint32_t)aus[5] << 16) * 0xc2b2ae35u);
+}
+
+static inline uint16_t
+CompactProb(float r)
+{
+    if (!(r > 0.0f))
+        return 0;
+    if (r >= 1.0f)
+        return 0xffff;
+    return (uint16_t)(r * 65535.0f + 0.5f);
+}
+
+static inline uint16_t
+CompactEquity(float r)
+{
+    float const x = r * COMPACT_EQUITY_SCALE;
+
+    if (!(x > -32768.0f))
+        return (uint16_t)(int16_t)-32768;
+    if (x >= 32767.0f)
+        return 32767;
+    return (uint16_t)(int16_t)(x < 0.0f ? x - 0.5f : x + 0.5f);
+}
+
+/* Index of the entry of line pl with fingerprint nFinger, copied to
+ * *pce, or CACHE_WAYS if it's not there */
+static inline int
+CompactFind(const cacheLine *restrict pl, uint32_t nFinger, cacheCompact *restrict pce)
+{
+    int i;
+
+    for (i = 0; i < CACHE_WAYS; i++) {
+        *pce = pl->ace[i];
+        if ((pce->nCheck ^ CompactMix(pce->aus)) == nFinger)
+            break;
+    }
+
+    return i;
+}
+
+/* Move entry i of line pl, a copy of which is *pce, to the front */
+static inline void
+CompactToFront(cacheLine *restrict pl, int i, const cacheCompact *restrict pce)
+{
+    for (; i > 0; i--)
+        pl->ace[i] = pl->ace[i - 1];
+    pl->ace[0] = *pce;
+}
+
+static inline void
+CompactOutputs(const cacheCompact *restrict pce, float *restrict arOut, float *restrict arCubeful)
+{
+    int i;
+
+    for (i = 0; i < 5 /*NUM_OUTPUTS */; i++)
+        arOut[i] = pce->aus[i] * (1.0f / 65535.0f);
+    if (arCubeful)
+        *arCubeful = (int16_t)pce->aus[5] / COMPACT_EQUITY_SCALE;
+}
+
+static uint32_t
+CacheLookupCompact(evalCache *restrict pc, const cacheNodeDetail *restrict e, float *restrict arOut, float *restrict arCubeful)
+{
+    uint64_t const h = CompactHash(e);
+    uint32_t const l = (uint32_t)h & pc->hashMask;
+    cacheLine *const pl = &pc->lines[l];
+    cacheCompact ce;
+    int i = CompactFind(pl, (uint32_t)(h >> 32) | 1, &ce);
+
+    if (i == CACHE_WAYS)
+        return l;
+
+    CompactToFront(pl, i, &ce);
+    CompactOutputs(&ce, arOut, arCubeful);
+
+    return CACHEHIT;
+}
+
+static uint32_t
+CacheLookupCompactWithLocking(evalCache *restrict pc, const cacheNodeDetail *restrict e, float *restrict arOut,
+                              float *restrict arCubeful)
+{
+    uint64_t const h = CompactHash(e);
+    uint32_t const l = (uint32_t)h & pc->hashMask;
+    cacheLine *const pl = &pc->lines[l];
+    atomic_uint *const pnSeq = &pc->anLineSeq[l & (CACHE_LINE_LOCKS - 1)];
+    unsigned int const nSeq = atomic_load_explicit(pnSeq, memory_order_acquire);
+    cacheCompact ce;
+    unsigned int n;
+    int i;
+
+    if (nSeq & 1)
+        return l;
+
+    i = CompactFind(pl, (uint32_t)(h >> 32) | 1, &ce);
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(pnSeq, memory_order_relaxed) != nSeq || i == CACHE_WAYS)
+        /* Cache miss, or the line changed while we read it */
+        return l;
+
+    if (i > 0 && SeqWriteBegin(pnSeq, &n)) {
+        if (n == nSeq)
+            CompactToFront(pl, i, &ce);
+        SeqWriteEnd(pnSeq, n);
+    }
+
+    CompactOutputs(&ce, arOut, arCubeful);
+
+    return CACHEHIT;
+}
+
+extern unsigned int
+CacheAddCompact(evalCache *restrict pc, const cacheNodeDetail *restrict e)
+{
+    uint64_t const h = CompactHash(e);
+    uint32_t const nFinger = (uint32_t)(h >> 32) | 1;
+    cacheLine *const pl = &pc->lines[(uint32_t)h & pc->hashMask];
+    cacheCompact ce;
+    unsigned int nAdd = 0;
+    int i;
+
+    /* Evict the least recently used entry, or an older copy of this one */
+    i = CompactFind(pl, nFinger, &ce);
+    if (i != 0 && pl->ace[0].nCheck)
+        nAdd |= CACHE_ADD_COLLIDE;
+    if (i == CACHE_WAYS) {
+        i--;
+        if (pl->ace[i].nCheck)
+            nAdd |= CACHE_ADD_EVICT;
+    }
+    for (; i > 0; i--)
+        pl->ace[i] = pl->ace[i - 1];
+
+    for (i = 0; i < 5 /*NUM_OUTPUTS */; i++)
+        ce.aus[i] = CompactProb(e->ar[i]);
+    ce.aus[5] = CompactEquity(e->ar[5]);
+    ce.nCheck = nFinger ^ CompactMix(ce.aus);
+    pl->ace[0] = ce;
+
+    return nAdd;
+}
+
 uint32_t
 CacheLookupWithLocking(evalCache *restrict pc, const cacheNodeDetail *restrict e, float *restrict arOut, float *restrict arCubeful)
 {
-    uint32_t const l = GetHashKey(pc->hashMask, e);
-
-    if (!EqualKeys(pc->entries[l].nd_primary.key, e->key) || pc->entries[l].nd_primary.nEvalContext != e->nEvalContext) {         /* Not in primary slot */
-        if (!EqualKeys(pc->entries[l].nd_secondary.key, e->key) || pc->entries[l].nd_secondary.nEvalContext != e->nEvalContext) { /* Cache miss */
-            return l;
-        } else { /* Found in second slot, promote "hot" entry */
-            cacheNodeDetail tmp = pc->entries[l].nd_primary;
+    if (pc->layout == CACHE_LAYOUT_COMPACT)
+        return CacheLookupCompactWithLocking(pc, e, arOut, arCubeful);
 
-            pc->entries[l].nd_primary = pc->entries[l].nd_secondary;
-            pc->entries[l].nd_secondary = tmp;
+    uint32_t const l = GetHashKey(pc->hashMask, e);
+    cacheNode *const pn = &pc->entries[l];
+    unsigned int const nSeq = atomic_load_explicit(&pn->nSeq, memory_order_acquire);
+    unsigned int const nGen = CacheGeneration(pc);
+    float ar[6];
+    int iSlot;
+
+    if (nSeq & 1)
+        return l;
+
+    if (EqualKeys(pn->nd_primary.key, e->key) && pn->nd_primary.nEvalContext == e->nEvalContext) {
+        memcpy(ar, pn->nd_primary.ar, sizeof(ar));
+        iSlot = 1;
+    } else if (EqualKeys(pn->nd_secondary.key, e->key) && pn->nd_secondary.nEvalContext == e->nEvalContext) {
+        memcpy(ar, pn->nd_secondary.ar, sizeof(ar));
+        iSlot = 2;
+    } else
+        iSlot = 0;
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&pn->nSeq, memory_order_relaxed) != nSeq || !iSlot)
+        /* Cache miss, or the node changed while we read it */
+        return l;
+
+    if (iSlot == 2 || pn->anGen[0] != nGen) {
+        /* Found in second slot, promote "hot" entry if nobody else has
+         * changed the node since; or renew the generation of the hit */
+        unsigned int n;
+
+        if (SeqWriteBegin(&pn->nSeq, &n)) {
+            if (n == nSeq) {
+                if (iSlot == 2) {
+                    cacheNodeDetail tmp = pn->nd_primary;
+
+                    pn->nd_primary = pn->nd_secondary;
+                    pn->nd_secondary = tmp;
+                    pn->anGen[1] = pn->anGen[0];
+                }
+                pn->anGen[0] = (uint8_t)nGen;
+            }
+            SeqWriteEnd(&pn->nSeq, n);
         }
     }
+
     /* Cache hit */
-    memcpy(arOut, pc->entries[l].nd_primary.ar, sizeof(float) * 5 /*NUM_OUTPUTS */);
+    memcpy(arOut, ar, sizeof(float) * 5 /*NUM_OUTPUTS */);
     if (arCubeful)
-        *arCubeful = pc->entries[l].nd_primary.ar[5]; /* Cubeful equity stored in slot 5 */
+        *arCubeful = ar[5]; /* Cubeful equity stored in slot 5 */
 
     return CACHEHIT;
 }
@@ -113,6 +397,9 @@ CacheLookupWithLocking(evalCache *restrict pc, const cacheNodeDetail *restrict e
 uint32_t
 CacheLookupNoLocking(evalCache *restrict pc, const cacheNodeDetail *restrict e, float *restrict arOut, float *restrict arCubeful)
 {
+    if (pc->layout == CACHE_LAYOUT_COMPACT)
+        return CacheLookupCompact(pc, e, arOut, arCubeful);
+
     uint32_t const l = GetHashKey(pc->hashMask, e);
 
     if (!EqualKeys(pc->entries[l].nd_primary.key, e->key) || pc->entries[l].nd_primary.nEvalContext != e->nEvalContext) {         /* Not in primary slot */
@@ -123,8 +410,10 @@ CacheLookupNoLocking(evalCache *restrict pc, const cacheNodeDetail *restrict e,
 
             pc->entries[l].nd_primary = pc->entries[l].nd_secondary;
             pc->entries[l].nd_secondary = tmp;
+            pc->entries[l].anGen[1] = pc->entries[l].anGen[0];
         }
     }
+    pc->entries[l].anGen[0] = (uint8_t)CacheGeneration(pc);
 
     /* Cache hit */
     memcpy(arOut, pc->entries[l].nd_primary.ar, sizeof(float) * 5 /*NUM_OUTPUTS */);
@@ -134,10 +423,36 @@ CacheLookupNoLocking(evalCache *restrict pc, const cacheNodeDetail *restrict e,
     return CACHEHIT;
 }
 
-void CacheAddWithLocking(evalCache *restrict pc, const cacheNodeDetail *restrict e, uint32_t l)
+unsigned int
+CacheAddWithLocking(evalCache *restrict pc, const cacheNodeDetail *restrict e, uint32_t l)
 {
-    pc->entries[l].nd_secondary = pc->entries[l].nd_primary;
-    pc->entries[l].nd_primary = *e;
+    unsigned int nSeq, nAdd;
+
+    if (pc->layout == CACHE_LAYOUT_COMPACT) {
+        atomic_uint *const pnSeq = &pc->anLineSeq[l & (CACHE_LINE_LOCKS - 1)];
+
+        if (!SeqWriteBegin(pnSeq, &nSeq))
+            return 0;
+        nAdd = CacheAddCompact(pc, e);
+        SeqWriteEnd(pnSeq, nSeq);
+
+        return nAdd;
+    }
+
+    cacheNode *const pn = &pc->entries[l];
+
+    if (!SeqWriteBegin(&pn->nSeq, &nSeq))
+        return 0;
+
+    unsigned int const nGen = (uint8_t)(atomic_fetch_add_explicit(&pc->cAdd, 1, memory_order_relaxed) >> pc->nGenShift);
+
+    nAdd = CacheMakeRoom(pn, e, nGen);
+    pn->nd_primary = *e;
+    pn->anGen[0] = (uint8_t)nGen;
+
+    SeqWriteEnd(&pn->nSeq, nSeq);
+
+    return nAdd;
 }
 
 /* CacheAddNoLocking() is inlined and in cache.h */
@@ -145,22 +460,75 @@ void CacheAddWithLocking(evalCache *restrict pc, const cacheNodeDetail *restrict
 void CacheDestroy(const evalCache *pc)
 {
     free(pc->entries);
+    free(pc->lines);
+    free(pc->anLineSeq);
 }
 
 void CacheFlush(const evalCache *pc)
 {
     unsigned int k;
+
+    if (pc->layout == CACHE_LAYOUT_COMPACT) {
+        if (pc->lines)
+            memset(pc->lines, 0, (pc->size / CACHE_WAYS) * sizeof(cacheLine));
+        if (pc->anLineSeq)
+            for (k = 0; k < CACHE_LINE_LOCKS; ++k)
+                atomic_init(&pc->anLineSeq[k], 0);
+        return;
+    }
+
     for (k = 0; k < pc->size / 2; ++k) {
         pc->entries[k].nd_primary.key.data[0] = (unsigned int)-1;
         pc->entries[k].nd_secondary.key.data[0] = (unsigned int)-1;
+        atomic_init(&pc->entries[k].nSeq, 0);
+        pc->entries[k].anGen[0] = pc->entries[k].anGen[1] = 0;
+    }
+}
+
+extern size_t
+CacheTableBytes(const evalCache *pc)
+{
+    if (pc->layout == CACHE_LAYOUT_COMPACT)
+        return (pc->size / CACHE_WAYS) * sizeof(cacheLine);
+    else
+        return (pc->size / 2) * sizeof(cacheNode);
+}
+
+extern int
+CacheWrite(const evalCache *pc, FILE *pf)
+{
+    size_t const cb = CacheTableBytes(pc);
+    const void *p = pc->layout == CACHE_LAYOUT_COMPACT ? (const void *)pc->lines : (const void *)pc->entries;
+
+    return cb && fwrite(p, 1, cb, pf) < cb ? -1 : 0;
+}
+
+/* On failure the cache is left empty rather than half read */
+extern int
+CacheRead(evalCache *pc, FILE *pf)
+{
+    size_t const cb = CacheTableBytes(pc);
+    void *p = pc->layout == CACHE_LAYOUT_COMPACT ? (void *)pc->lines : (void *)pc->entries;
+    unsigned int k;
+
+    if (cb && fread(p, 1, cb, pf) < cb) {
+        CacheFlush(pc);
+        return -1;
     }
+
+    /* no write can be in progress in a node just read */
+    if (pc->layout == CACHE_LAYOUT_FULL)
+        for (k = 0; k < pc->size / 2; ++k)
+            atomic_init(&pc->entries[k].nSeq, 0);
+
+    return 0;
 }
 
 int CacheResize(evalCache *pc, unsigned int cNew)
 {
     if (cNew != pc->size) {
         CacheDestroy(pc);
-        if (CacheCreate(pc, cNew) != 0)
+        if (CacheCreate(pc, cNew, pc->layout) != 0)
             return -1;
     }
 
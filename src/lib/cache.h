@@ -21,13 +21,12 @@
 
 #include "config.h"
 
-#ifdef HAVE_STDINT_H
 #include <stdint.h>
-#else
-typedef unsigned int uint32_t;
-#endif
+#include <stdio.h>
+#include <stdatomic.h>
 
 #include "gnubg-types.h"
+#include "positionid.h"
 
 /* Set to calculate simple cache stats */
 #define CACHE_STATS 0
@@ -41,40 +40,160 @@ typedef struct {
 typedef struct {
     cacheNodeDetail nd_primary;
     cacheNodeDetail nd_secondary;
+    atomic_uint nSeq;           /* odd while being written, see cache.c */
+    uint8_t anGen[2];           /* generation of the last use of each entry */
 } cacheNode;
 
+/*
+ * EvalKey() keeps the plies of an evaluation in bits 0-3 of nEvalContext
+ * and xors the keys of cubeful equities with CACHE_KEY_CUBEFUL, the only
+ * one to set bits 29 and 30.
+ */
+#define CACHE_KEY_CUBEFUL 0x6a47b47e
+
+/* A secondary entry one ply deeper than the primary one outlives it by
+ * this many generations, see CacheKeepSecondary(); 0 is the policy of
+ * gnubg, which always demotes the primary entry (see tests/bench_cache.c) */
+#ifndef CACHE_PLY_AGE
+#define CACHE_PLY_AGE 4
+#endif
+
 /* name used in eval.c */
 typedef cacheNodeDetail evalcache;
 
+/* Compact layout: the key and context are reduced to a 32 bit
+ * fingerprint and the outputs to 16 bit fixed point, see cache.c */
+#define CACHE_WAYS 4
+
 typedef struct {
-    cacheNode *entries;
+    uint32_t nCheck;            /* fingerprint ^ CompactMix(aus) */
+    uint16_t aus[6];
+} cacheCompact;
+
+typedef struct {
+    _Alignas(64) cacheCompact ace[CACHE_WAYS]; /* most recently used first */
+} cacheLine;
+
+typedef enum {
+    CACHE_LAYOUT_FULL,          /* two full entries per node */
+    CACHE_LAYOUT_COMPACT        /* CACHE_WAYS fingerprinted entries per line */
+} cachelayout;
+
+typedef struct {
+    cacheNode *entries;         /* CACHE_LAYOUT_FULL */
+    cacheLine *lines;           /* CACHE_LAYOUT_COMPACT */
+    atomic_uint *anLineSeq;     /* sequence counts of the lines, see cache.c */
 
     unsigned int size;
     uint32_t hashMask;
+    cachelayout layout;
+    atomic_uint cAdd;           /* entries added, a generation every size / 2 */
+    unsigned int nGenShift;     /* log2(size / 2) */
 } evalCache;
 
-/* Cache size will be adjusted to a power of 2 */
-int CacheCreate(evalCache * pc, unsigned int size);
+/* Cache size (number of entries) will be adjusted to a power of 2; the
+ * compact layout only stores probabilities in [0, 1] and an equity in
+ * [-4, 4] in ar[5], so it is not for caches of anything else */
+int CacheCreate(evalCache * pc, unsigned int size, cachelayout layout);
 int CacheResize(evalCache * pc, unsigned int cNew);
 
 #define CACHEHIT ((uint32_t)-1)
 
-/* returns a value which is passed to CacheAdd (if a miss) */
+/* returns a value which is passed to CacheAdd (if a miss); the
+ * WithLocking variants can be used by several threads at once */
 unsigned int CacheLookupWithLocking(evalCache * pc, const cacheNodeDetail * e, float *arOut, float *arCubeful);
 unsigned int CacheLookupNoLocking(evalCache * pc, const cacheNodeDetail * e, float *arOut, float *arCubeful);
 
-void CacheAddWithLocking(evalCache * pc, const cacheNodeDetail * e, uint32_t l);
+/* The CacheAdd functions return a combination of these */
+#define CACHE_ADD_COLLIDE 1     /* the bucket held another position */
+#define CACHE_ADD_EVICT 2       /* an entry was pushed out */
+
+unsigned int CacheAddWithLocking(evalCache * pc, const cacheNodeDetail * e, uint32_t l);
+unsigned int CacheAddCompact(evalCache * pc, const cacheNodeDetail * e);
+
+static inline unsigned int
+CacheGeneration(const evalCache * pc)
+{
+    return (uint8_t)(atomic_load_explicit(&pc->cAdd, memory_order_relaxed) >> pc->nGenShift);
+}
+
+static inline int
+CachePlies(int nEvalContext)
+{
+    if (nEvalContext & 0x60000000)
+        nEvalContext ^= CACHE_KEY_CUBEFUL;
+
+    return nEvalContext & 0xf;
+}
+
+/*
+ * A new entry always goes in the primary slot, as it is the most likely
+ * to be looked up again soon; the entry it displaces goes in the
+ * secondary slot, unless the secondary entry is worth more.  The worth
+ * of an entry is its plies times CACHE_PLY_AGE less its age, in
+ * generations since it was added or last hit, so that a deep result is
+ * not lost to a stream of shallow ones but doesn't stay for ever either.
+ */
+static inline int
+CacheKeepSecondary(const cacheNode * pn, unsigned int nGen)
+{
+    return CACHE_PLY_AGE > 0 && pn->nd_secondary.key.data[0] != (unsigned int)-1 &&
+        CachePlies(pn->nd_secondary.nEvalContext) * CACHE_PLY_AGE - (int)(uint8_t)(nGen - pn->anGen[1]) >
+        CachePlies(pn->nd_primary.nEvalContext) * CACHE_PLY_AGE - (int)(uint8_t)(nGen - pn->anGen[0]);
+}
 
-static inline void
+/* Move the primary entry of pn out of the way of a new one, see
+ * CacheKeepSecondary(); returns the CACHE_ADD flags */
+static inline unsigned int
+CacheMakeRoom(cacheNode * pn, const cacheNodeDetail * e, unsigned int nGen)
+{
+    unsigned int nAdd = 0;
+
+    if (pn->nd_primary.key.data[0] != (unsigned int)-1 &&
+        (!EqualKeys(pn->nd_primary.key, e->key) || pn->nd_primary.nEvalContext != e->nEvalContext))
+        nAdd |= CACHE_ADD_COLLIDE;
+
+    if (CacheKeepSecondary(pn, nGen))
+        nAdd |= CACHE_ADD_EVICT;
+    else {
+        if (pn->nd_secondary.key.data[0] != (unsigned int)-1)
+            nAdd |= CACHE_ADD_EVICT;
+        pn->nd_secondary = pn->nd_primary;
+        pn->anGen[1] = pn->anGen[0];
+    }
+
+    return nAdd;
+}
+
+static inline unsigned int
 CacheAddNoLocking(evalCache * pc, const cacheNodeDetail * e, const uint32_t l)
 {
-    pc->entries[l].nd_secondary = pc->entries[l].nd_primary;
-    pc->entries[l].nd_primary = *e;
+    if (pc->layout == CACHE_LAYOUT_COMPACT)
+        return CacheAddCompact(pc, e);
+
+    cacheNode *const pn = &pc->entries[l];
+    unsigned int const cAdd = atomic_load_explicit(&pc->cAdd, memory_order_relaxed);
+    unsigned int const nGen = (uint8_t)(cAdd >> pc->nGenShift);
+    unsigned int nAdd;
+
+    atomic_store_explicit(&pc->cAdd, cAdd + 1, memory_order_relaxed);
+
+    nAdd = CacheMakeRoom(pn, e, nGen);
+    pn->nd_primary = *e;
+    pn->anGen[0] = (uint8_t)nGen;
+
+    return nAdd;
 }
 
 void CacheFlush(const evalCache * pc);
 void CacheDestroy(const evalCache * pc);
 
+/* The table of pc is written and read exactly as it is in memory, so a
+ * file is only good for the same build and the same layout and size */
+size_t CacheTableBytes(const evalCache * pc);
+int CacheWrite(const evalCache * pc, FILE * pf);
+int CacheRead(evalCache * pc, FILE * pf);
+
 #if defined(HAVE_FUNC_ATTRIBUTE_PURE)
 uint32_t GetHashKey(uint32_t hashMask, const cacheNodeDetail * e) __attribute((pure));
 #else
@@ -35,6 +35,10 @@
 typedef float float_vector[4];
 #endif /* USE_SIMD_INSTRUCTIONS */
 
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
 typedef SSE_ALIGN(float float_vec_aligned[sizeof(float_vector)/sizeof(float)]);
 
 SSE_ALIGN (static float_vec_aligned inpvec[16]) = {
@@ -82,6 +86,14 @@ baseInputs(const TanBoard anBoard, float arInput[])
         float *afInput = arInput + j * 25 * 4;
         const unsigned int *board = anBoard[j];
 
+#if defined(__wasm_simd128__)
+        /* Points */
+        for (i = 0; i < 24; i++)
+            wasm_v128_store(afInput + i * 4, wasm_v128_load(inpvec[board[i]]));
+
+        /* Bar */
+        wasm_v128_store(afInput + 24 * 4, wasm_v128_load(inpvecb[board[24]]));
+#else
         /* Points */
         for (i = 0; i < 24; i++) {
             const unsigned int nc = board[i];
@@ -101,5 +113,6 @@ baseInputs(const TanBoard anBoard, float arInput[])
             afInput[24 * 4 + 2] = inpvecb[nc][2];
             afInput[24 * 4 + 3] = inpvecb[nc][3];
         }
+#endif
     }
 }
@@ -30,6 +30,10 @@
 
 SSE_ALIGN(ThreadData td);
 
+/* Every ThreadLocalData there is, for MT_SumCacheCounts() */
+static ThreadLocalData *aptld[MAX_NUMTHREADS + 1];
+static unsigned int ctld;
+
 extern ThreadLocalData *
 MT_CreateThreadLocalData(int id)
 {
@@ -37,18 +41,50 @@ MT_CreateThreadLocalData(int id)
     tld->id = id;
     tld->pnnState = (NNState *) g_malloc(sizeof(NNState) * 3);
     // cppcheck-suppress duplicateExpression
-    tld->pnnState[CLASS_RACE - CLASS_RACE].savedBase = g_malloc0(nnRace.cHidden * sizeof(float));
+    tld->pnnState[CLASS_RACE - CLASS_RACE].savedBase = g_malloc0(nnRace.cHiddenPad * sizeof(float));
     // cppcheck-suppress duplicateExpression
     tld->pnnState[CLASS_RACE - CLASS_RACE].savedIBase = g_malloc0(nnRace.cInput * sizeof(float));
-    tld->pnnState[CLASS_CRASHED - CLASS_RACE].savedBase = g_malloc0(nnCrashed.cHidden * sizeof(float));
+    tld->pnnState[CLASS_CRASHED - CLASS_RACE].savedBase = g_malloc0(nnCrashed.cHiddenPad * sizeof(float));
     tld->pnnState[CLASS_CRASHED - CLASS_RACE].savedIBase = g_malloc0(nnCrashed.cInput * sizeof(float));
-    tld->pnnState[CLASS_CONTACT - CLASS_RACE].savedBase = g_malloc0(nnContact.cHidden * sizeof(float));
+    tld->pnnState[CLASS_CONTACT - CLASS_RACE].savedBase = g_malloc0(nnContact.cHiddenPad * sizeof(float));
     tld->pnnState[CLASS_CONTACT - CLASS_RACE].savedIBase = g_malloc0(nnContact.cInput * sizeof(float));
+    /* no incremental evaluations, see ScoreMoves() */
+    tld->pnnState[0].state = tld->pnnState[1].state = tld->pnnState[2].state = NNSTATE_NONE;
 
     tld->aMoves = (move *) g_malloc0(sizeof(move) * MAX_INCOMPLETE_MOVES);
+    tld->aMoveIndex = (unsigned int *) g_malloc0(sizeof(unsigned int) * MOVE_INDEX_SIZE);
+    tld->nMoveIndexStamp = 0;
+    tld->pcc = (cachecounts *) g_malloc0(sizeof(cachecounts));
+    tld->aRaceHalf = (racehalf *) g_malloc0(sizeof(racehalf) << RACE_HALF_CACHE_BITS);
+
+    if (ctld < sizeof(aptld) / sizeof(aptld[0]))
+        aptld[ctld++] = tld;
+
     return tld;
 }
 
+/* The counters are plain per thread counters, read while the threads
+ * may be adding to them: the sums are only as good as statistics need */
+extern void
+MT_SumCacheCounts(cachecounts * pcc, int fReset)
+{
+    unsigned long long *pn = &pcc->aac[0][0][0][0];
+    unsigned int const cn = sizeof(pcc->aac) / sizeof(*pn);
+    unsigned int i, j;
+
+    memset(pcc, 0, sizeof(*pcc));
+
+    for (i = 0; i < ctld; i++) {
+        const unsigned long long *pnThread = &aptld[i]->pcc->aac[0][0][0][0];
+
+        for (j = 0; j < cn; j++)
+            pn[j] += pnThread[j];
+
+        if (fReset)
+            memset(aptld[i]->pcc, 0, sizeof(cachecounts));
+    }
+}
+
 extern void
 MT_InitThreads(void)
 {
@@ -65,11 +101,15 @@ MT_Close(void)
         return;
 
     g_free(td.tld->aMoves);
+    g_free(td.tld->aMoveIndex);
     pnnState = td.tld->pnnState;
     for (i = 0; i < 3; i++) {
         g_free(pnnState[i].savedBase);
         g_free(pnnState[i].savedIBase);
     }
     g_free(pnnState);
+    g_free(td.tld->pcc);
+    g_free(td.tld->aRaceHalf);
     g_free(td.tld);
+    ctld = 0;
 }
@@ -20,35 +20,176 @@
 #include "backgammon.h"
 #include "common.h"
 #include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
 
 #include "neuralnet.h"
+#include "neuralnetsimd.h"
 #include "simd.h"
 #include "sigmoid.h"
 
+/*
+ * The weights are kept in the layout the kernels walk, set up when a net
+ * is loaded:
+ *
+ * - the hidden layer is padded with zeros to cHiddenPad nodes, a multiple
+ *   of NN_HIDDEN_ALIGN, which is the stride of the rows of arHiddenWeight
+ *   (one per input) and the length of arHiddenThreshold; the kernels never
+ *   need a scalar tail
+ * - arOutputWeight is cut in blocks of NN_HIDDEN_ALIGN hidden nodes, and
+ *   each block holds the weights of those nodes for output 0, then for
+ *   output 1, etc.: the output layer reads it once from start to end and
+ *   loads each block of activations only once
+ *
+ * The weights files keep the original dense layout, unless written with
+ * NN_BINARY_LAYOUT or NN_BINARY_MAPPED.
+ */
+
+static inline size_t
+OutputWeight(const neuralnet * pnn, unsigned int i, unsigned int j)
+{
+    return ((size_t) (j / NN_HIDDEN_ALIGN) * pnn->cOutput + i) * NN_HIDDEN_ALIGN + j % NN_HIDDEN_ALIGN;
+}
+
+/* Portable kernel, also the reference for the SIMD ones */
+
+static void
+HiddenLayerScalar(const float arWeight[], unsigned int cHidden, unsigned int cBatch,
+                  const nninput aan[], unsigned int cStride, const unsigned int ac[], float aar[])
+{
+    unsigned int b, j, k;
+
+    /* no blocking: this is only the fallback for hosts without SIMD */
+    for (b = 0; b < cBatch; b++)
+        for (k = 0; k < ac[b]; k++) {
+            const float *prWeight = arWeight + aan[b * cStride + k].i * cHidden;
+            float const ari = aan[b * cStride + k].r;
+            float *pr = aar + b * cHidden;
+
+            for (j = cHidden; j; j--)
+                *pr++ += *prWeight++ * ari;
+        }
+}
+
+static void
+HiddenLayerQScalar(const void *aqWeight, int nBits, unsigned int cHidden, unsigned int cBatch,
+                   const nninput aan[], unsigned int cStride, const unsigned int ac[], float aar[])
+{
+    unsigned int b, j, k;
+
+    for (b = 0; b < cBatch; b++)
+        for (k = 0; k < ac[b]; k++) {
+            size_t const iRow = (size_t) aan[b * cStride + k].i * cHidden;
+            float const ari = aan[b * cStride + k].r;
+            float *pr = aar + b * cHidden;
+
+            for (j = 0; j < cHidden; j++)
+                pr[j] += QuantWeight(aqWeight, nBits, iRow + j) * ari;
+        }
+}
+
+static void
+OutputLayerScalar(const neuralnet * pnn, const float ar[], float arOutput[])
+{
+    unsigned int i, j;
+
+    for (i = 0; i < pnn->cOutput; i++) {
+        float r = pnn->arOutputThreshold[i];
+
+        for (j = 0; j < pnn->cHidden; j++)
+            r += ar[j] * pnn->arOutputWeight[OutputWeight(pnn, i, j)];
+
+        arOutput[i] = r;
+    }
+}
+
+static void
+SigmoidScalar(float ar[], unsigned int c, float rBeta)
+{
+    unsigned int i;
+
+    for (i = 0; i < c; i++)
+        ar[i] = sigmoid(-rBeta * ar[i]);
+}
+
+static const nnkernel nnkScalar = { "scalar", HiddenLayerScalar, HiddenLayerQScalar, OutputLayerScalar, SigmoidScalar };
+
+/* Kernel used by NeuralNetEvaluate(), chosen when the weights are loaded */
+static const nnkernel *pnnk = &nnkScalar;
+
+extern unsigned int
+NeuralNetKernels(const nnkernel *apnnk[NN_MAX_KERNELS])
+{
+    unsigned int c = NeuralNetKernelsSSE(apnnk);
+
+    if ((apnnk[c] = NeuralNetKernelWasm()) != NULL)
+        c++;
+
+    apnnk[c++] = &nnkScalar;
+
+    return c;
+}
+
+static void
+NeuralNetSelectKernel(void)
+{
+    const nnkernel *apnnk[NN_MAX_KERNELS];
+
+    NeuralNetKernels(apnnk);
+    pnnk = apnnk[0];
+}
+
+extern int
+SIMD_Supported(void)
+{
+    return pnnk != &nnkScalar;
+}
+
+extern const char *
+NeuralNetKernelName(void)
+{
+    return pnnk->szName;
+}
+
 static int
 NeuralNetCreate(neuralnet * pnn, unsigned int cInput, unsigned int cHidden,
                 unsigned int cOutput, float rBetaHidden, float rBetaOutput)
 {
+    unsigned int const cHiddenPad = (cHidden + NN_HIDDEN_ALIGN - 1) / NN_HIDDEN_ALIGN * NN_HIDDEN_ALIGN;
+
+    if (cOutput > NN_MAX_OUTPUTS) {
+        errno = EINVAL;
+        return -1;
+    }
+
     pnn->cInput = cInput;
     pnn->cHidden = cHidden;
+    pnn->cHiddenPad = cHiddenPad;
     pnn->cOutput = cOutput;
     pnn->rBetaHidden = rBetaHidden;
     pnn->rBetaOutput = rBetaOutput;
     pnn->nTrained = 0;
+    pnn->arBoardWeight = NULL;
+    pnn->nQuant = 0;
+    pnn->qHidden.aq = pnn->qBoard.aq = NULL;
+    pnn->qHidden.arScale = pnn->qBoard.arScale = NULL;
+    pnn->qHidden.arScaleHidden = pnn->qBoard.arScaleHidden = NULL;
+    pnn->fMapped = FALSE;
+
+    NeuralNetSelectKernel();
 
-    if ((pnn->arHiddenWeight = sse_malloc(cHidden * cInput * sizeof(float))) == NULL)
+    if ((pnn->arHiddenWeight = sse_malloc(cHiddenPad * cInput * sizeof(float))) == NULL)
         return -1;
 
-    if ((pnn->arOutputWeight = sse_malloc(cOutput * cHidden * sizeof(float))) == NULL) {
+    if ((pnn->arOutputWeight = sse_malloc(cOutput * cHiddenPad * sizeof(float))) == NULL) {
         sse_free(pnn->arHiddenWeight);
         return -1;
     }
 
-    if ((pnn->arHiddenThreshold = sse_malloc(cHidden * sizeof(float))) == NULL) {
+    if ((pnn->arHiddenThreshold = sse_malloc(cHiddenPad * sizeof(float))) == NULL) {
         sse_free(pnn->arOutputWeight);
         sse_free(pnn->arHiddenWeight);
         return -1;
@@ -61,24 +202,33 @@ NeuralNetCreate(neuralnet * pnn, unsigned int cInput, unsigned int cHidden,
         return -1;
     }
 
+    /* the padding must be zero */
+    memset(pnn->arHiddenWeight, 0, cHiddenPad * cInput * sizeof(float));
+    memset(pnn->arOutputWeight, 0, cOutput * cHiddenPad * sizeof(float));
+    memset(pnn->arHiddenThreshold, 0, cHiddenPad * sizeof(float));
+
     return 0;
 }
 
 extern void
 NeuralNetDestroy(neuralnet * pnn)
 {
-    sse_free(pnn->arHiddenWeight);
+    if (!pnn->fMapped) {
+        sse_free(pnn->arHiddenWeight);
+        sse_free(pnn->arOutputWeight);
+        sse_free(pnn->arHiddenThreshold);
+        sse_free(pnn->arOutputThreshold);
+        sse_free(pnn->arBoardWeight);
+    }
     pnn->arHiddenWeight = 0;
-    sse_free(pnn->arOutputWeight);
     pnn->arOutputWeight = 0;
-    sse_free(pnn->arHiddenThreshold);
     pnn->arHiddenThreshold = 0;
-    sse_free(pnn->arOutputThreshold);
     pnn->arOutputThreshold = 0;
+    pnn->arBoardWeight = 0;
+    pnn->fMapped = FALSE;
+    NeuralNetQuantize(pnn, 0);
 }
 
-#if !defined(USE_SIMD_INSTRUCTIONS)
-
 /* separate context for race, crashed, contact
  * -1: regular eval
  * 0: save base
@@ -116,106 +266,111 @@ NNevalAction(NNState * pnState)
 }
 
 static void
-Evaluate(const neuralnet * pnn, const float arInput[], float ar[], float arOutput[], float *saveAr)
+Activate(const neuralnet * pnn, float ar[], float arOutput[])
 {
-    const unsigned int cHidden = pnn->cHidden;
-    unsigned int i, j;
-    float *prWeight;
+    /* the padding nodes stay at 0 and have no output weights */
+    pnnk->Sigmoid(ar, pnn->cHidden, pnn->rBetaHidden);
 
-    /* Calculate activity at hidden nodes */
-    for (i = 0; i < cHidden; i++)
-        ar[i] = pnn->arHiddenThreshold[i];
-
-    prWeight = pnn->arHiddenWeight;
+    /* Calculate activity at output nodes */
+    pnnk->OutputLayer(pnn, ar, arOutput);
 
-    for (i = 0; i < pnn->cInput; i++) {
-        float const ari = arInput[i];
+    pnnk->Sigmoid(arOutput, pnn->cOutput, pnn->rBetaOutput);
+}
 
-        if (ari == 0.0f)
-            prWeight += cHidden;
-        else {
-            float *pr = ar;
+/* Collect the non-zero inputs, so that the kernels can walk them once
+ * per block of hidden nodes without testing again */
+static unsigned int
+ActiveInputs(const float arInput[], unsigned int cInput, nninput an[])
+{
+    unsigned int i, c = 0;
 
-            if (ari == 1.0f)
-                for (j = cHidden; j; j--)
-                    *pr++ += *prWeight++;
-            else
-                for (j = cHidden; j; j--)
-                    *pr++ += *prWeight++ * ari;
+    for (i = 0; i < cInput; i++)
+        if (arInput[i] != 0.0f) {
+            an[c].i = i;
+            an[c].r = arInput[i];
+            c++;
         }
+
+    return c;
+}
+
+/* Add the weighted inputs to the hidden nodes, through the quantized
+ * weights if the net has them; fBoard selects the board table */
+static void
+HiddenSum(const neuralnet * pnn, int fBoard, unsigned int cBatch,
+          const nninput aan[], unsigned int cStride, const unsigned int ac[], float aar[])
+{
+    const nnqweights *pq = fBoard ? &pnn->qBoard : &pnn->qHidden;
+    nninput *aanScaled;
+    float *aarSum;
+    unsigned int b, k;
+
+    if (!pnn->nQuant) {
+        pnnk->HiddenLayer(fBoard ? pnn->arBoardWeight : pnn->arHiddenWeight, pnn->cHiddenPad, cBatch,
+                          aan, cStride, ac, aar);
+        return;
     }
 
-    if (saveAr)
-        memcpy(saveAr, ar, cHidden * sizeof(*saveAr));
+    if (cBatch == 0)
+        return;
 
-    for (i = 0; i < cHidden; i++)
-        ar[i] = sigmoid(-pnn->rBetaHidden * ar[i]);
+    /* the scale of each row goes with its input, the scale of each
+     * hidden node with its sum */
+    aanScaled = (nninput *) g_alloca(cBatch * cStride * sizeof(nninput));
+    for (b = 0; b < cBatch; b++)
+        for (k = 0; k < ac[b]; k++) {
+            const nninput *pn = aan + b * cStride + k;
 
-    /* Calculate activity at output nodes */
-    prWeight = pnn->arOutputWeight;
+            aanScaled[b * cStride + k].i = pn->i;
+            aanScaled[b * cStride + k].r = pn->r * pq->arScale[pn->i];
+        }
 
-    for (i = 0; i < pnn->cOutput; i++) {
-        float r = pnn->arOutputThreshold[i];
+    aarSum = (float *) g_alloca(cBatch * pnn->cHiddenPad * sizeof(float));
+    memset(aarSum, 0, cBatch * pnn->cHiddenPad * sizeof(float));
 
-        for (j = 0; j < cHidden; j++)
-            r += ar[j] * *prWeight++;
+    pnnk->HiddenLayerQ(pq->aq, pnn->nQuant, pnn->cHiddenPad, cBatch, aanScaled, cStride, ac, aarSum);
 
-        arOutput[i] = sigmoid(-pnn->rBetaOutput * r);
-    }
+    for (b = 0; b < cBatch; b++)
+        for (k = 0; k < pnn->cHiddenPad; k++)
+            aar[b * pnn->cHiddenPad + k] += aarSum[b * pnn->cHiddenPad + k] * pq->arScaleHidden[k];
 }
 
 static void
-EvaluateFromBase(const neuralnet * pnn, const float arInputDif[], float ar[], float arOutput[])
+HiddenLayer(const neuralnet * pnn, const float arInput[], float ar[])
 {
-    unsigned int i, j;
-    float *prWeight;
+    nninput *an = (nninput *) g_alloca(pnn->cInput * sizeof(nninput));
+    unsigned int c = ActiveInputs(arInput, pnn->cInput, an);
 
-    /* Calculate activity at hidden nodes */
-    /*    for( i = 0; i < pnn->cHidden; i++ )
-     * ar[ i ] = pnn->arHiddenThreshold[ i ]; */
-
-    prWeight = pnn->arHiddenWeight;
-
-    for (i = 0; i < pnn->cInput; ++i) {
-        float const ari = arInputDif[i];
-
-        if (ari == 0.0f)
-            prWeight += pnn->cHidden;
-        else {
-            float *pr = ar;
+    HiddenSum(pnn, FALSE, 1, an, pnn->cInput, &c, ar);
+}
 
-            if (ari == 1.0f)
-                for (j = pnn->cHidden; j; j--)
-                    *pr++ += *prWeight++;
-            else if (ari == -1.0f)
-                for (j = pnn->cHidden; j; j--)
-                    *pr++ -= *prWeight++;
-            else
-                for (j = pnn->cHidden; j; j--)
-                    *pr++ += *prWeight++ * ari;
-        }
-    }
+static void
+Evaluate(const neuralnet * pnn, const float arInput[], float ar[], float arOutput[], float *saveAr)
+{
+    /* Calculate activity at hidden nodes */
+    memcpy(ar, pnn->arHiddenThreshold, pnn->cHiddenPad * sizeof(*ar));
 
-    for (i = 0; i < pnn->cHidden; i++)
-        ar[i] = sigmoid(-pnn->rBetaHidden * ar[i]);
+    HiddenLayer(pnn, arInput, ar);
 
-    /* Calculate activity at output nodes */
-    prWeight = pnn->arOutputWeight;
+    if (saveAr)
+        memcpy(saveAr, ar, pnn->cHiddenPad * sizeof(*saveAr));
 
-    for (i = 0; i < pnn->cOutput; i++) {
-        float r = pnn->arOutputThreshold[i];
+    Activate(pnn, ar, arOutput);
+}
 
-        for (j = 0; j < pnn->cHidden; j++)
-            r += ar[j] * *prWeight++;
+static void
+EvaluateFromBase(const neuralnet * pnn, const float arInputDif[], float ar[], float arOutput[])
+{
+    /* Calculate activity at hidden nodes, ar[] holds the saved base */
+    HiddenLayer(pnn, arInputDif, ar);
 
-        arOutput[i] = sigmoid(-pnn->rBetaOutput * r);
-    }
+    Activate(pnn, ar, arOutput);
 }
 
 extern int
 NeuralNetEvaluate(const neuralnet * pnn, float arInput[], float arOutput[], NNState * pnState)
 {
-    float *ar = (float *) g_alloca(pnn->cHidden * sizeof(float));
+    float *ar = (float *) g_alloca(pnn->cHiddenPad * sizeof(float));
     switch (NNevalAction(pnState)) {
     case NNEVAL_NONE:
         {
@@ -235,7 +390,7 @@ NeuralNetEvaluate(const neuralnet * pnn, float arInput[], float arOutput[], NNSt
                 Evaluate(pnn, arInput, ar, arOutput, 0);
                 break;
             }
-            memcpy(ar, pnState->savedBase, pnn->cHidden * sizeof(*ar));
+            memcpy(ar, pnState->savedBase, pnn->cHiddenPad * sizeof(*ar));
 
             {
                 float *r = arInput;
@@ -256,14 +411,274 @@ NeuralNetEvaluate(const neuralnet * pnn, float arInput[], float arOutput[], NNSt
     }
     return 0;
 }
-#endif
+
+extern int
+NeuralNetEvaluateSparse(const neuralnet * pnn, unsigned int cBatch, const nninput aan[], unsigned int cStride,
+                        const unsigned int ac[], float aarOutput[])
+{
+    float *aar = (float *) g_alloca(cBatch * pnn->cHiddenPad * sizeof(float));
+    unsigned int b;
+
+    for (b = 0; b < cBatch; b++)
+        memcpy(aar + b * pnn->cHiddenPad, pnn->arHiddenThreshold, pnn->cHiddenPad * sizeof(*aar));
+
+    HiddenSum(pnn, FALSE, cBatch, aan, cStride, ac, aar);
+
+    for (b = 0; b < cBatch; b++)
+        Activate(pnn, aar + b * pnn->cHiddenPad, aarOutput + b * pnn->cOutput);
+
+    return 0;
+}
+
+extern int
+NeuralNetEvaluateBatch(const neuralnet * pnn, unsigned int cBatch, const float aarInput[], float aarOutput[])
+{
+    nninput *aan = (nninput *) g_alloca(cBatch * pnn->cInput * sizeof(nninput));
+    unsigned int *ac = (unsigned int *) g_alloca(cBatch * sizeof(unsigned int));
+    unsigned int b;
+
+    if (cBatch == 0)
+        return 0;
+
+    for (b = 0; b < cBatch; b++)
+        ac[b] = ActiveInputs(aarInput + b * pnn->cInput, pnn->cInput, aan + b * pnn->cInput);
+
+    return NeuralNetEvaluateSparse(pnn, cBatch, aan, pnn->cInput, ac, aarOutput);
+}
+
+/*
+ * The first NN_BOARD_INPUTS inputs of the contact, crashed and pruning
+ * nets are four per point and side, and depend only on the number of
+ * chequers there (see baseInputs()).  Their contribution to the hidden
+ * layer can then be tabulated: arBoardWeight holds one row per side,
+ * point and count, followed by the rows of arHiddenWeight for the
+ * remaining inputs, and an evaluation only adds up one row per occupied
+ * point instead of multiplying out the whole board.
+ */
+
+#define NN_BOARD_COUNTS 16
+#define NN_BOARD_ROWS (2 * 25 * NN_BOARD_COUNTS)
+
+static inline unsigned int
+BoardRow(unsigned int side, unsigned int point, unsigned int n)
+{
+    return (side * 25 + point) * NN_BOARD_COUNTS + n;
+}
+
+extern int
+NeuralNetBoardTable(neuralnet * pnn, void (*pfBaseInputs) (const TanBoard anBoard, float arInput[]))
+{
+    unsigned int const cHidden = pnn->cHiddenPad;
+    float arInput[NN_BOARD_INPUTS];
+    TanBoard anBoard;
+    unsigned int n, j, i, k;
+
+    if (pnn->fMapped) {
+        /* the table came with the weights, and cannot be rebuilt there */
+        if (pnn->arBoardWeight)
+            return 0;
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (pnn->cInput < NN_BOARD_INPUTS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    sse_free(pnn->arBoardWeight);
+    if ((pnn->arBoardWeight = sse_malloc((NN_BOARD_ROWS + pnn->cInput - NN_BOARD_INPUTS) * cHidden * sizeof(float))) == NULL)
+        return -1;
+
+    memset(pnn->arBoardWeight, 0, NN_BOARD_ROWS * cHidden * sizeof(float));
+
+    for (n = 1; n < NN_BOARD_COUNTS; n++) {
+        /* a board with n chequers everywhere gives the inputs of every
+         * point for that count */
+        for (j = 0; j < 2; j++)
+            for (i = 0; i < 25; i++)
+                anBoard[j][i] = n;
+
+        pfBaseInputs((ConstTanBoard) anBoard, arInput);
+
+        for (j = 0; j < 2; j++)
+            for (i = 0; i < 25; i++) {
+                nninput an[4];
+                unsigned int c = 0;
+
+                for (k = 0; k < 4; k++) {
+                    unsigned int const iInput = (j * 25 + i) * 4 + k;
+
+                    if (arInput[iInput] != 0.0f) {
+                        an[c].i = iInput;
+                        an[c].r = arInput[iInput];
+                        c++;
+                    }
+                }
+
+                pnnk->HiddenLayer(pnn->arHiddenWeight, cHidden, 1, an, 0, &c,
+                                  pnn->arBoardWeight + BoardRow(j, i, n) * cHidden);
+            }
+    }
+
+    memcpy(pnn->arBoardWeight + NN_BOARD_ROWS * cHidden, pnn->arHiddenWeight + NN_BOARD_INPUTS * cHidden,
+           (pnn->cInput - NN_BOARD_INPUTS) * cHidden * sizeof(float));
+
+    /* keep the quantized copy in step */
+    return pnn->nQuant ? NeuralNetQuantize(pnn, pnn->nQuant) : 0;
+}
+
+static void
+QuantizeFree(nnqweights * pq)
+{
+    sse_free(pq->aq);
+    pq->aq = NULL;
+    sse_free(pq->arScale);
+    pq->arScale = NULL;
+    sse_free(pq->arScaleHidden);
+    pq->arScaleHidden = NULL;
+}
+
+static int
+QuantizeWeights(nnqweights * pq, const float arWeight[], unsigned int cRow, unsigned int cHidden, int nBits)
+{
+    int const nMax = (1 << (nBits - 1)) - 1;
+    size_t const cb = nBits / 8;
+    unsigned int i, j;
+
+    QuantizeFree(pq);
+
+    if ((pq->aq = sse_malloc((size_t) cRow * cHidden * cb)) == NULL ||
+        (pq->arScale = sse_malloc(cRow * sizeof(float))) == NULL ||
+        (pq->arScaleHidden = sse_malloc(cHidden * sizeof(float))) == NULL) {
+        QuantizeFree(pq);
+        return -1;
+    }
+
+    /* symmetric: normalise each hidden node to its largest weight, then
+     * put the largest normalised weight of each row on nMax */
+    for (j = 0; j < cHidden; j++) {
+        float rMax = 0.0f;
+
+        for (i = 0; i < cRow; i++)
+            rMax = MAX(rMax, fabsf(arWeight[(size_t) i * cHidden + j]));
+
+        pq->arScaleHidden[j] = rMax > 0.0f ? rMax : 1.0f;
+    }
+
+    for (i = 0; i < cRow; i++) {
+        float rMax = 0.0f;
+
+        for (j = 0; j < cHidden; j++)
+            rMax = MAX(rMax, fabsf(arWeight[(size_t) i * cHidden + j] / pq->arScaleHidden[j]));
+
+        pq->arScale[i] = rMax > 0.0f ? rMax / nMax : 1.0f;
+    }
+
+    for (i = 0; i < cRow; i++)
+        for (j = 0; j < cHidden; j++) {
+            size_t const k = (size_t) i * cHidden + j;
+            long const n = lrintf(arWeight[k] / pq->arScaleHidden[j] / pq->arScale[i]);
+
+            if (nBits == 8)
+                ((int8_t *) pq->aq)[k] = (int8_t) n;
+            else
+                ((int16_t *) pq->aq)[k] = (int16_t) n;
+        }
+
+    return 0;
+}
+
+extern int
+NeuralNetQuantize(neuralnet * pnn, int nBits)
+{
+    if (nBits == 0) {
+        QuantizeFree(&pnn->qHidden);
+        QuantizeFree(&pnn->qBoard);
+        pnn->nQuant = 0;
+        return 0;
+    }
+
+    if (nBits != 16 && nBits != 8) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (QuantizeWeights(&pnn->qHidden, pnn->arHiddenWeight, pnn->cInput, pnn->cHiddenPad, nBits) ||
+        (pnn->arBoardWeight &&
+         QuantizeWeights(&pnn->qBoard, pnn->arBoardWeight, NN_BOARD_ROWS + pnn->cInput - NN_BOARD_INPUTS,
+                         pnn->cHiddenPad, nBits))) {
+        NeuralNetQuantize(pnn, 0);
+        return -1;
+    }
+
+    pnn->nQuant = nBits;
+
+    return 0;
+}
+
+/* List the rows of the board table selected by anBoard and by the
+ * inputs after NN_BOARD_INPUTS; return their number */
+static unsigned int
+BoardInputs(const neuralnet * pnn, const TanBoard anBoard, const float arInput[], nninput an[])
+{
+    unsigned int c = 0, j, i;
+
+    for (j = 0; j < 2; j++)
+        for (i = 0; i < 25; i++)
+            if (anBoard[j][i]) {
+                an[c].i = BoardRow(j, i, MIN(anBoard[j][i], NN_BOARD_COUNTS - 1));
+                an[c].r = 1.0f;
+                c++;
+            }
+
+    for (i = NN_BOARD_INPUTS; i < pnn->cInput; i++)
+        if (arInput[i] != 0.0f) {
+            an[c].i = NN_BOARD_ROWS + i - NN_BOARD_INPUTS;
+            an[c].r = arInput[i];
+            c++;
+        }
+
+    return c;
+}
+
+/* Room for the rows of a position */
+#define BOARD_STRIDE(pnn) (2 * 2 * 25 + (pnn)->cInput - NN_BOARD_INPUTS)
+
+extern int
+NeuralNetEvaluateBoard(const neuralnet * pnn, unsigned int cBatch, const TanBoard aanBoard[],
+                       const float aarInput[], float aarOutput[])
+{
+    unsigned int const cStride = BOARD_STRIDE(pnn);
+    float *aar = (float *) g_alloca(cBatch * pnn->cHiddenPad * sizeof(float));
+    nninput *aan = (nninput *) g_alloca(cBatch * cStride * sizeof(nninput));
+    unsigned int *ac = (unsigned int *) g_alloca(cBatch * sizeof(unsigned int));
+    unsigned int b;
+
+    g_assert(pnn->arBoardWeight);
+
+    if (cBatch == 0)
+        return 0;
+
+    for (b = 0; b < cBatch; b++) {
+        memcpy(aar + b * pnn->cHiddenPad, pnn->arHiddenThreshold, pnn->cHiddenPad * sizeof(*aar));
+        ac[b] = BoardInputs(pnn, aanBoard[b], aarInput ? aarInput + b * pnn->cInput : NULL,
+                            aan + b * cStride);
+    }
+
+    HiddenSum(pnn, TRUE, cBatch, aan, cStride, ac, aar);
+
+    for (b = 0; b < cBatch; b++)
+        Activate(pnn, aar + b * pnn->cHiddenPad, aarOutput + b * pnn->cOutput);
+
+    return 0;
+}
 
 extern int
 NeuralNetLoad(neuralnet * pnn, FILE * pf)
 {
 
-    unsigned int i;
-    float *pr;
+    unsigned int i, j;
     char dummy[16];
 
     if (fscanf(pf, "%u %u %u %15s %f %f\n", &pnn->cInput, &pnn->cHidden,
@@ -279,30 +694,34 @@ NeuralNetLoad(neuralnet * pnn, FILE * pf)
 
     pnn->nTrained = 1;
 
-    for (i = pnn->cInput * pnn->cHidden, pr = pnn->arHiddenWeight; i; i--)
-        if (fscanf(pf, "%f\n", pr++) < 1)
-            return -1;
+    for (i = 0; i < pnn->cInput; i++)
+        for (j = 0; j < pnn->cHidden; j++)
+            if (fscanf(pf, "%f\n", pnn->arHiddenWeight + i * pnn->cHiddenPad + j) < 1)
+                return -1;
 
-    for (i = pnn->cHidden * pnn->cOutput, pr = pnn->arOutputWeight; i; i--)
-        if (fscanf(pf, "%f\n", pr++) < 1)
-            return -1;
+    for (i = 0; i < pnn->cOutput; i++)
+        for (j = 0; j < pnn->cHidden; j++)
+            if (fscanf(pf, "%f\n", pnn->arOutputWeight + OutputWeight(pnn, i, j)) < 1)
+                return -1;
 
-    for (i = pnn->cHidden, pr = pnn->arHiddenThreshold; i; i--)
-        if (fscanf(pf, "%f\n", pr++) < 1)
+    for (j = 0; j < pnn->cHidden; j++)
+        if (fscanf(pf, "%f\n", pnn->arHiddenThreshold + j) < 1)
             return -1;
 
-    for (i = pnn->cOutput, pr = pnn->arOutputThreshold; i; i--)
-        if (fscanf(pf, "%f\n", pr++) < 1)
+    for (i = 0; i < pnn->cOutput; i++)
+        if (fscanf(pf, "%f\n", pnn->arOutputThreshold + i) < 1)
             return -1;
 
     return 0;
 }
 
 extern int
-NeuralNetLoadBinary(neuralnet * pnn, FILE * pf)
+NeuralNetLoadBinary(neuralnet * pnn, FILE * pf, int nFormat)
 {
 
     int dummy;
+    unsigned int i, j, cHiddenPad, nAlign;
+    float *ar;
 
 #define FREAD( p, c ) \
     if ( fread( (p), sizeof( *(p) ), (c), pf ) < (unsigned int)(c) ) return -1
@@ -324,8 +743,34 @@ NeuralNetLoadBinary(neuralnet * pnn, FILE * pf)
 
     pnn->nTrained = 1;
 
-    FREAD(pnn->arHiddenWeight, pnn->cInput * pnn->cHidden);
-    FREAD(pnn->arOutputWeight, pnn->cHidden * pnn->cOutput);
+    if (nFormat == NN_BINARY_LAYOUT) {
+        /* the arrays as they are in memory, if this build pads the same */
+        FREAD(&cHiddenPad, 1);
+        FREAD(&nAlign, 1);
+
+        if (cHiddenPad != pnn->cHiddenPad || nAlign != NN_HIDDEN_ALIGN) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        FREAD(pnn->arHiddenWeight, pnn->cInput * pnn->cHiddenPad);
+        FREAD(pnn->arOutputWeight, pnn->cHiddenPad * pnn->cOutput);
+        FREAD(pnn->arHiddenThreshold, pnn->cHiddenPad);
+        FREAD(pnn->arOutputThreshold, pnn->cOutput);
+
+        return 0;
+    }
+
+    for (i = 0; i < pnn->cInput; i++)
+        FREAD(pnn->arHiddenWeight + i * pnn->cHiddenPad, pnn->cHidden);
+
+    ar = (float *) g_alloca(pnn->cHidden * sizeof(float));
+    for (i = 0; i < pnn->cOutput; i++) {
+        FREAD(ar, pnn->cHidden);
+        for (j = 0; j < pnn->cHidden; j++)
+            pnn->arOutputWeight[OutputWeight(pnn, i, j)] = ar[j];
+    }
+
     FREAD(pnn->arHiddenThreshold, pnn->cHidden);
     FREAD(pnn->arOutputThreshold, pnn->cOutput);
 #undef FREAD
@@ -333,13 +778,85 @@ NeuralNetLoadBinary(neuralnet * pnn, FILE * pf)
     return 0;
 }
 
+/*
+ * An NN_BINARY_MAPPED record is made of sections that each start at a
+ * multiple of NN_MAP_ALIGN bytes from the start of the record, so that
+ * the arrays can be used where they lie once the file is mapped:
+ *
+ * - an nnmapheader
+ * - arHiddenWeight, arOutputWeight, arHiddenThreshold, arOutputThreshold
+ *   and arBoardWeight (if cBoardRows is not 0), in the layout above
+ */
+
+typedef struct {
+    unsigned int cInput;
+    unsigned int cHidden;
+    unsigned int cOutput;
+    int nTrained;
+    float rBetaHidden;
+    float rBetaOutput;
+    unsigned int cHiddenPad;
+    unsigned int nAlign;        /* NN_HIDDEN_ALIGN */
+    unsigned int cBoardRows;    /* rows of arBoardWeight, 0 if none */
+} nnmapheader;
+
+static inline size_t
+MapSize(size_t cb)
+{
+    return (cb + NN_MAP_ALIGN - 1) / NN_MAP_ALIGN * NN_MAP_ALIGN;
+}
+
+static int
+WriteSection(const void *p, size_t cb, FILE * pf)
+{
+    static const char achZero[NN_MAP_ALIGN];
+
+    if (fwrite(p, 1, cb, pf) < cb || fwrite(achZero, 1, MapSize(cb) - cb, pf) < MapSize(cb) - cb)
+        return -1;
+
+    return 0;
+}
+
+static int
+SaveMapped(const neuralnet * pnn, FILE * pf)
+{
+    nnmapheader h;
+
+    memset(&h, 0, sizeof(h));
+    h.cInput = pnn->cInput;
+    h.cHidden = pnn->cHidden;
+    h.cOutput = pnn->cOutput;
+    h.nTrained = pnn->nTrained;
+    h.rBetaHidden = pnn->rBetaHidden;
+    h.rBetaOutput = pnn->rBetaOutput;
+    h.cHiddenPad = pnn->cHiddenPad;
+    h.nAlign = NN_HIDDEN_ALIGN;
+    h.cBoardRows = pnn->arBoardWeight ? NN_BOARD_ROWS + pnn->cInput - NN_BOARD_INPUTS : 0;
+
+    if (WriteSection(&h, sizeof(h), pf) ||
+        WriteSection(pnn->arHiddenWeight, (size_t) pnn->cInput * pnn->cHiddenPad * sizeof(float), pf) ||
+        WriteSection(pnn->arOutputWeight, (size_t) pnn->cOutput * pnn->cHiddenPad * sizeof(float), pf) ||
+        WriteSection(pnn->arHiddenThreshold, pnn->cHiddenPad * sizeof(float), pf) ||
+        WriteSection(pnn->arOutputThreshold, pnn->cOutput * sizeof(float), pf) ||
+        (h.cBoardRows && WriteSection(pnn->arBoardWeight, (size_t) h.cBoardRows * pnn->cHiddenPad * sizeof(float), pf)))
+        return -1;
+
+    return 0;
+}
+
 extern int
-NeuralNetSaveBinary(const neuralnet * pnn, FILE * pf)
+NeuralNetSaveBinary(const neuralnet * pnn, FILE * pf, int nFormat)
 {
 
+    unsigned int i, j, nAlign = NN_HIDDEN_ALIGN;
+    float *ar;
+
 #define FWRITE( p, c ) \
     if ( fwrite( (p), sizeof( *(p) ), (c), pf ) < (unsigned int)(c) ) return -1
 
+    if (nFormat == NN_BINARY_MAPPED)
+        return SaveMapped(pnn, pf);
+
     FWRITE(&pnn->cInput, 1);
     FWRITE(&pnn->cHidden, 1);
     FWRITE(&pnn->cOutput, 1);
@@ -347,11 +864,135 @@ NeuralNetSaveBinary(const neuralnet * pnn, FILE * pf)
     FWRITE(&pnn->rBetaHidden, 1);
     FWRITE(&pnn->rBetaOutput, 1);
 
-    FWRITE(pnn->arHiddenWeight, pnn->cInput * pnn->cHidden);
-    FWRITE(pnn->arOutputWeight, pnn->cHidden * pnn->cOutput);
+    if (nFormat == NN_BINARY_LAYOUT) {
+        FWRITE(&pnn->cHiddenPad, 1);
+        FWRITE(&nAlign, 1);
+
+        FWRITE(pnn->arHiddenWeight, pnn->cInput * pnn->cHiddenPad);
+        FWRITE(pnn->arOutputWeight, pnn->cHiddenPad * pnn->cOutput);
+        FWRITE(pnn->arHiddenThreshold, pnn->cHiddenPad);
+        FWRITE(pnn->arOutputThreshold, pnn->cOutput);
+
+        return 0;
+    }
+
+    for (i = 0; i < pnn->cInput; i++)
+        FWRITE(pnn->arHiddenWeight + i * pnn->cHiddenPad, pnn->cHidden);
+
+    ar = (float *) g_alloca(pnn->cHidden * sizeof(float));
+    for (i = 0; i < pnn->cOutput; i++) {
+        for (j = 0; j < pnn->cHidden; j++)
+            ar[j] = pnn->arOutputWeight[OutputWeight(pnn, i, j)];
+        FWRITE(ar, pnn->cHidden);
+    }
+
     FWRITE(pnn->arHiddenThreshold, pnn->cHidden);
     FWRITE(pnn->arOutputThreshold, pnn->cOutput);
 #undef FWRITE
 
     return 0;
 }
+
+/* FNV-1a on 32 bit words */
+static unsigned int
+HashFloats(unsigned int nHash, const float ar[], size_t c)
+{
+    size_t i;
+
+    for (i = 0; i < c; i++) {
+        unsigned int n;
+
+        memcpy(&n, ar + i, sizeof(n));
+        nHash = (nHash ^ n) * 16777619u;
+    }
+
+    return nHash;
+}
+
+extern unsigned int
+NeuralNetHash(const neuralnet * pnn, unsigned int nHash)
+{
+    float const ar[] = { (float) pnn->cInput, (float) pnn->cHidden, (float) pnn->cOutput,
+        pnn->rBetaHidden, pnn->rBetaOutput
+    };
+
+    /* the padding of the hidden layer is all zeros */
+    nHash = HashFloats(nHash, ar, sizeof(ar) / sizeof(ar[0]));
+    nHash = HashFloats(nHash, pnn->arHiddenWeight, (size_t) pnn->cInput * pnn->cHiddenPad);
+    nHash = HashFloats(nHash, pnn->arOutputWeight, (size_t) pnn->cOutput * pnn->cHiddenPad);
+    nHash = HashFloats(nHash, pnn->arHiddenThreshold, pnn->cHiddenPad);
+
+    return HashFloats(nHash, pnn->arOutputThreshold, pnn->cOutput);
+}
+
+/* Take the next section of cb bytes from *pp, or NULL if there is not
+ * enough left */
+static float *
+MapSection(const unsigned char **pp, size_t * pcb, size_t cb)
+{
+    const unsigned char *p = *pp;
+
+    if (MapSize(cb) > *pcb)
+        return NULL;
+
+    *pp += MapSize(cb);
+    *pcb -= MapSize(cb);
+
+    /* never written through, see NeuralNetDestroy() */
+    return (float *) (uintptr_t) p;
+}
+
+extern int
+NeuralNetMap(neuralnet * pnn, const void **pp, size_t * pcb)
+{
+    const unsigned char *p = *pp;
+    size_t cb = *pcb;
+    nnmapheader h;
+    neuralnet nn;
+
+    if ((uintptr_t) p % ALIGN_SIZE_MALLOC || cb < MapSize(sizeof(h))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memcpy(&h, p, sizeof(h));
+    p += MapSize(sizeof(h));
+    cb -= MapSize(sizeof(h));
+
+    /* a file of another build, or not a net at all */
+    if (h.cInput < 1 || h.cInput > 0xffff || h.cHidden < 1 || h.cHidden > 0xffff ||
+        h.cOutput < 1 || h.cOutput > NN_MAX_OUTPUTS || !(h.rBetaHidden > 0.0f) || !(h.rBetaOutput > 0.0f) ||
+        h.nAlign != NN_HIDDEN_ALIGN || h.cHiddenPad != (h.cHidden + NN_HIDDEN_ALIGN - 1) / NN_HIDDEN_ALIGN * NN_HIDDEN_ALIGN ||
+        (h.cBoardRows && (h.cInput < NN_BOARD_INPUTS || h.cBoardRows != NN_BOARD_ROWS + h.cInput - NN_BOARD_INPUTS))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(&nn, 0, sizeof(nn));
+    nn.cInput = h.cInput;
+    nn.cHidden = h.cHidden;
+    nn.cHiddenPad = h.cHiddenPad;
+    nn.cOutput = h.cOutput;
+    nn.nTrained = h.nTrained;
+    nn.rBetaHidden = h.rBetaHidden;
+    nn.rBetaOutput = h.rBetaOutput;
+    nn.fMapped = TRUE;
+
+    if ((nn.arHiddenWeight = MapSection(&p, &cb, (size_t) h.cInput * h.cHiddenPad * sizeof(float))) == NULL ||
+        (nn.arOutputWeight = MapSection(&p, &cb, (size_t) h.cOutput * h.cHiddenPad * sizeof(float))) == NULL ||
+        (nn.arHiddenThreshold = MapSection(&p, &cb, h.cHiddenPad * sizeof(float))) == NULL ||
+        (nn.arOutputThreshold = MapSection(&p, &cb, h.cOutput * sizeof(float))) == NULL ||
+        (h.cBoardRows &&
+         (nn.arBoardWeight = MapSection(&p, &cb, (size_t) h.cBoardRows * h.cHiddenPad * sizeof(float))) == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    NeuralNetSelectKernel();
+
+    *pnn = nn;
+    *pp = p;
+    *pcb = cb;
+
+    return 0;
+}
@@ -21,10 +21,40 @@
 
 #include <stdio.h>
 #include "common.h"
+#include "gnubg-types.h"
+
+/* Number of leading inputs that depend only on the chequers on each
+ * point, four per point and side */
+#define NN_BOARD_INPUTS (2 * 25 * 4)
+
+/* The hidden layer is padded to a multiple of this many nodes, the
+ * width of the vectors of the kernels */
+#define NN_HIDDEN_ALIGN 8
+
+/* The output layer keeps one accumulator per output in registers */
+#define NN_MAX_OUTPUTS 8
+
+/* Formats of NeuralNetLoadBinary() and NeuralNetSaveBinary() */
+#define NN_BINARY_DENSE 1       /* the original gnubg.wd layout */
+#define NN_BINARY_LAYOUT 2      /* padded and interleaved as in memory */
+#define NN_BINARY_MAPPED 3      /* the same with the board table, for NeuralNetMap() */
+
+/* Sections of NN_BINARY_MAPPED files start at multiples of this */
+#define NN_MAP_ALIGN 64
+
+/* Weights stored as nBits integers, with a scale per input row and one
+ * per hidden node: weight i of hidden node j is
+ * aq[i * cHiddenPad + j] * arScale[i] * arScaleHidden[j] */
+typedef struct {
+    void *aq;
+    float *arScale;
+    float *arScaleHidden;
+} nnqweights;
 
 typedef struct {
     unsigned int cInput;
     unsigned int cHidden;
+    unsigned int cHiddenPad;    /* cHidden rounded up to NN_HIDDEN_ALIGN */
     unsigned int cOutput;
     int nTrained;
     float rBetaHidden;
@@ -33,8 +63,19 @@ typedef struct {
     float *arOutputWeight;
     float *arHiddenThreshold;
     float *arOutputThreshold;
+    float *arBoardWeight;       /* see NeuralNetBoardTable() */
+    int nQuant;                 /* bits of the quantized weights, 0 if none */
+    nnqweights qHidden;         /* arHiddenWeight, see NeuralNetQuantize() */
+    nnqweights qBoard;          /* arBoardWeight */
+    int fMapped;                /* the float arrays are not ours, see NeuralNetMap() */
 } neuralnet;
 
+/* A non-zero input: the row of weights it selects and its value */
+typedef struct {
+    unsigned int i;
+    float r;
+} nninput;
+
 typedef enum {
     NNEVAL_NONE,
     NNEVAL_SAVE,
@@ -51,21 +92,44 @@ typedef struct {
     NNStateType state;
     float *savedBase;
     float *savedIBase;
-#if !defined(USE_SIMD_INSTRUCTIONS)
     unsigned int cSavedIBase;
-#endif
 } NNState;
 
 extern void NeuralNetDestroy(neuralnet * pnn);
-#if !defined(USE_SIMD_INSTRUCTIONS)
 extern int NeuralNetEvaluate(const neuralnet * pnn, float arInput[], float arOutput[], NNState * pnState);
-#else
-extern int NeuralNetEvaluateSSE(const neuralnet * pnn, float arInput[], float arOutput[], NNState * pnState);
-#endif
+/* Evaluate cBatch positions at once: aarInput holds cBatch vectors of
+ * cInput inputs and aarOutput receives cBatch vectors of cOutput outputs */
+extern int NeuralNetEvaluateBatch(const neuralnet * pnn, unsigned int cBatch, const float aarInput[], float aarOutput[]);
+/* Same with each position given by its non-zero inputs only, ac[b] of
+ * them listed from aan[b * cStride] in increasing order of i; inputs
+ * builders that know which ones those are skip the dense vector */
+extern int NeuralNetEvaluateSparse(const neuralnet * pnn, unsigned int cBatch, const nninput aan[], unsigned int cStride,
+                                   const unsigned int ac[], float aarOutput[]);
+/* Tabulate the contribution to the hidden layer of the first
+ * NN_BOARD_INPUTS inputs for each side, point and chequer count, as
+ * computed by pfBaseInputs; needed by NeuralNetEvaluateBoard() */
+extern int NeuralNetBoardTable(neuralnet * pnn, void (*pfBaseInputs) (const TanBoard anBoard, float arInput[]));
+/* Like NeuralNetEvaluateBatch(), with the first NN_BOARD_INPUTS inputs
+ * taken from the boards through the table; only the inputs after those
+ * are read from aarInput, which can be NULL if there are none */
+extern int NeuralNetEvaluateBoard(const neuralnet * pnn, unsigned int cBatch, const TanBoard aanBoard[],
+                                  const float aarInput[], float aarOutput[]);
+/* Evaluate with the first layer weights quantized to nBits (16 or 8)
+ * integers, or with the float weights again if nBits is 0 */
+extern int NeuralNetQuantize(neuralnet * pnn, int nBits);
 extern int NeuralNetLoad(neuralnet * pnn, FILE * pf);
-extern int NeuralNetLoadBinary(neuralnet * pnn, FILE * pf);
-extern int NeuralNetSaveBinary(const neuralnet * pnn, FILE * pf);
+extern int NeuralNetLoadBinary(neuralnet * pnn, FILE * pf, int nFormat);
+extern int NeuralNetSaveBinary(const neuralnet * pnn, FILE * pf, int nFormat);
+/* Fold the shape and the float weights of pnn into nHash, to tell one
+ * set of weights from another */
+extern unsigned int NeuralNetHash(const neuralnet * pnn, unsigned int nHash);
+/* Point pnn at the NN_BINARY_MAPPED record at *pp, of at most *pcb
+ * bytes, instead of copying it, and advance *pp and *pcb past it; the
+ * memory must outlive the net and is never written */
+extern int NeuralNetMap(neuralnet * pnn, const void **pp, size_t * pcb);
+/* Non-zero if NeuralNetEvaluate() uses a SIMD kernel (picked at run time) */
 extern int SIMD_Supported(void);
+extern const char *NeuralNetKernelName(void);
 
 /* Try to determine whether we are 64-bit or 32-bit */
 #if defined(_WIN32) || defined(_WIN64)
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2025 Alessandro Scotti
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Neural net evaluation kernels, internal to lib/neuralnet*.c
+ *
+ * A kernel only does the linear algebra of the two layers; collecting
+ * the non-zero inputs, the incremental evaluation logic and the
+ * activation function stay in neuralnet.c and are shared by all of them.
+ */
+
+#ifndef NEURALNETSIMD_H
+#define NEURALNETSIMD_H
+
+#include "neuralnet.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    const char *szName;
+    /* For each b < cBatch, add to row b of aar[] (cHidden floats) the
+     * rows i of arWeight[] times r, for the ac[b] inputs listed from
+     * aan[b * cStride]; aar[] holds the thresholds or a saved base on
+     * entry.  cHidden is the padded size of the layer, a multiple of
+     * NN_HIDDEN_ALIGN.  The weights are walked one block of hidden nodes at a
+     * time, reusing each block for the whole batch while it is in
+     * cache, and each row is summed in list order whatever cBatch is. */
+    void (*HiddenLayer)(const float arWeight[], unsigned int cHidden, unsigned int cBatch,
+                        const nninput aan[], unsigned int cStride, const unsigned int ac[], float aar[]);
+    /* Same with the weights in aqWeight[] quantized to nBits (16 or 8)
+     * integers; the caller applies the scales to the sums */
+    void (*HiddenLayerQ)(const void *aqWeight, int nBits, unsigned int cHidden, unsigned int cBatch,
+                         const nninput aan[], unsigned int cStride, const unsigned int ac[], float aar[]);
+    /* arOutput[i] = threshold + dot(ar, weights of output i), before
+     * the activation function; arOutputWeight is interleaved in blocks
+     * of NN_HIDDEN_ALIGN hidden nodes (see neuralnet.c) */
+    void (*OutputLayer)(const neuralnet *pnn, const float ar[], float arOutput[]);
+    /* ar[i] = sigmoid(-rBeta * ar[i]) for i < c */
+    void (*Sigmoid)(float ar[], unsigned int c, float rBeta);
+} nnkernel;
+
+/*
+ * The SIMD kernels compute the same piecewise function as sigmoid() in
+ * sigmoid.h, 1 / (1 + e[i] * (10 - i + 10x)) with i = (int) (10x) and
+ * the symmetric value for x < 0, but they cannot gather from the table:
+ * e[i] = exp(i / 10) / 10 is evaluated as 2^n * exp(r), with a Cody-Waite
+ * reduction of i / 10 by ln(2) and the Cephes polynomial for exp(r).
+ *
+ * Over every float in [-10.5, 10.5] (an exhaustive check) the result is
+ * within NN_SIGMOID_MAX_ERROR of sigmoid(); beyond it both are constant.
+ */
+#define NN_SIGMOID_MAX_ERROR 1.2e-7f
+
+#define NN_SIG_LOG2E_10 0.14426950408889634f     /* log2(e) / 10 */
+#define NN_SIG_LN2_10_HI 6.9315185546875f        /* 10 ln(2), exact product with n < 16 */
+#define NN_SIG_LN2_10_LO -4.674908804691569e-05f /* 10 ln(2) - NN_SIG_LN2_10_HI */
+#define NN_SIG_EXP_P0 1.9875691500e-4f
+#define NN_SIG_EXP_P1 1.3981999507e-3f
+#define NN_SIG_EXP_P2 8.3334519073e-3f
+#define NN_SIG_EXP_P3 4.1665795894e-2f
+#define NN_SIG_EXP_P4 1.6666665459e-1f
+#define NN_SIG_EXP_P5 5.0000001201e-1f
+#define NN_SIG_TAIL (1.0f / 19931.370438230298f) /* sigmoid(x) for x >= 10 */
+
+/* Weight i of a matrix quantized to nBits, for the scalar loops */
+static inline float
+QuantWeight(const void *aq, int nBits, size_t i)
+{
+    return nBits == 8 ? ((const int8_t *)aq)[i] : ((const int16_t *)aq)[i];
+}
+
+/* Store the kernels the host CPU supports in apnnk[], best first, and
+ * return their number */
+extern unsigned int NeuralNetKernelsSSE(const nnkernel *apnnk[2]);
+
+/* Return the simd128 kernel if the module was built for it, or NULL */
+extern const nnkernel *NeuralNetKernelWasm(void);
+
+/* Store all the kernels that can run here in apnnk[], best first and the
+ * scalar one last, and return their number; NeuralNetEvaluate() uses the
+ * first, the others are there to be checked against it */
+#define NN_MAX_KERNELS 4
+
+extern unsigned int NeuralNetKernels(const nnkernel *apnnk[NN_MAX_KERNELS]);
+
+#endif
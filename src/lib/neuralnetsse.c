@@ -0,0 +1,487 @@
+/*
+ * Copyright (C) 2025 Alessandro Scotti
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * SSE2 and AVX2/FMA neural net kernels for x86.
+ *
+ * The whole program is compiled for the baseline instruction set; the
+ * kernels below are compiled for their own target with function
+ * attributes and NeuralNetKernelsSSE() checks for them with cpuid at run time,
+ * so the same binary runs on any x86 CPU.
+ */
+
+#include "config.h"
+#include "glib_shim.h"
+#include "neuralnetsimd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+/* Number of hidden nodes kept in registers while walking the inputs */
+#define AVX_BLOCK 32
+#define SSE_BLOCK 16
+
+/* cHidden is always a whole number of AVX vectors, see NN_HIDDEN_ALIGN */
+#if NN_HIDDEN_ALIGN != 8
+#error "the output layer kernels expect blocks of 8 hidden nodes"
+#endif
+
+__attribute__((target("avx2,fma"))) static void
+HiddenLayerAVX2(const float arWeight[], unsigned int cHidden, unsigned int cBatch,
+                const nninput aan[], unsigned int cStride, const unsigned int ac[], float aar[])
+{
+    unsigned int b, j = 0, k;
+
+    for (; j + AVX_BLOCK <= cHidden; j += AVX_BLOCK)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            float *ar = aar + b * cHidden + j;
+            __m256 s0 = _mm256_loadu_ps(ar);
+            __m256 s1 = _mm256_loadu_ps(ar + 8);
+            __m256 s2 = _mm256_loadu_ps(ar + 16);
+            __m256 s3 = _mm256_loadu_ps(ar + 24);
+
+            for (k = 0; k < ac[b]; k++) {
+                const float *pr = arWeight + an[k].i * cHidden + j;
+                __m256 const x = _mm256_set1_ps(an[k].r);
+
+                s0 = _mm256_fmadd_ps(_mm256_loadu_ps(pr), x, s0);
+                s1 = _mm256_fmadd_ps(_mm256_loadu_ps(pr + 8), x, s1);
+                s2 = _mm256_fmadd_ps(_mm256_loadu_ps(pr + 16), x, s2);
+                s3 = _mm256_fmadd_ps(_mm256_loadu_ps(pr + 24), x, s3);
+            }
+
+            _mm256_storeu_ps(ar, s0);
+            _mm256_storeu_ps(ar + 8, s1);
+            _mm256_storeu_ps(ar + 16, s2);
+            _mm256_storeu_ps(ar + 24, s3);
+        }
+
+    for (; j + 8 <= cHidden; j += 8)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            __m256 s = _mm256_loadu_ps(aar + b * cHidden + j);
+
+            for (k = 0; k < ac[b]; k++)
+                s = _mm256_fmadd_ps(_mm256_loadu_ps(arWeight + an[k].i * cHidden + j), _mm256_set1_ps(an[k].r), s);
+
+            _mm256_storeu_ps(aar + b * cHidden + j, s);
+        }
+}
+
+__attribute__((target("avx2,fma"))) static inline __m256
+LoadQAVX2(const void *aq, int nBits, size_t i)
+{
+    if (nBits == 8)
+        return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)((const int8_t *)aq + i))));
+
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)((const int16_t *)aq + i))));
+}
+
+__attribute__((target("avx2,fma"))) static void
+HiddenLayerQAVX2(const void *aqWeight, int nBits, unsigned int cHidden, unsigned int cBatch,
+                 const nninput aan[], unsigned int cStride, const unsigned int ac[], float aar[])
+{
+    unsigned int b, j = 0, k;
+
+    for (; j + AVX_BLOCK <= cHidden; j += AVX_BLOCK)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            float *ar = aar + b * cHidden + j;
+            __m256 s0 = _mm256_loadu_ps(ar);
+            __m256 s1 = _mm256_loadu_ps(ar + 8);
+            __m256 s2 = _mm256_loadu_ps(ar + 16);
+            __m256 s3 = _mm256_loadu_ps(ar + 24);
+
+            for (k = 0; k < ac[b]; k++) {
+                size_t const iRow = (size_t)an[k].i * cHidden + j;
+                __m256 const x = _mm256_set1_ps(an[k].r);
+
+                s0 = _mm256_fmadd_ps(LoadQAVX2(aqWeight, nBits, iRow), x, s0);
+                s1 = _mm256_fmadd_ps(LoadQAVX2(aqWeight, nBits, iRow + 8), x, s1);
+                s2 = _mm256_fmadd_ps(LoadQAVX2(aqWeight, nBits, iRow + 16), x, s2);
+                s3 = _mm256_fmadd_ps(LoadQAVX2(aqWeight, nBits, iRow + 24), x, s3);
+            }
+
+            _mm256_storeu_ps(ar, s0);
+            _mm256_storeu_ps(ar + 8, s1);
+            _mm256_storeu_ps(ar + 16, s2);
+            _mm256_storeu_ps(ar + 24, s3);
+        }
+
+    for (; j + 8 <= cHidden; j += 8)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            __m256 s = _mm256_loadu_ps(aar + b * cHidden + j);
+
+            for (k = 0; k < ac[b]; k++)
+                s = _mm256_fmadd_ps(LoadQAVX2(aqWeight, nBits, (size_t)an[k].i * cHidden + j),
+                                    _mm256_set1_ps(an[k].r), s);
+
+            _mm256_storeu_ps(aar + b * cHidden + j, s);
+        }
+}
+
+__attribute__((target("avx2,fma"))) static void
+OutputLayerAVX2(const neuralnet *pnn, const float ar[], float arOutput[])
+{
+    const float *prWeight = pnn->arOutputWeight;
+    __m256 as[NN_MAX_OUTPUTS];
+    unsigned int i, j;
+
+    for (i = 0; i < pnn->cOutput; i++)
+        as[i] = _mm256_setzero_ps();
+
+    for (j = 0; j < pnn->cHiddenPad; j += 8) {
+        __m256 const x = _mm256_loadu_ps(ar + j);
+
+        for (i = 0; i < pnn->cOutput; i++, prWeight += 8)
+            as[i] = _mm256_fmadd_ps(x, _mm256_load_ps(prWeight), as[i]);
+    }
+
+    for (i = 0; i < pnn->cOutput; i++) {
+        __m128 h = _mm_add_ps(_mm256_castps256_ps128(as[i]), _mm256_extractf128_ps(as[i], 1));
+
+        h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+        h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+        arOutput[i] = pnn->arOutputThreshold[i] + _mm_cvtss_f32(h);
+    }
+}
+
+__attribute__((target("avx2,fma"))) static inline __m256
+ExpTenthAVX2(__m256 fi)
+{
+    /* exp(i / 10) / 10 for the integers i in fi, see neuralnetsimd.h */
+    __m256 const n = _mm256_round_ps(_mm256_mul_ps(fi, _mm256_set1_ps(NN_SIG_LOG2E_10)),
+                                     _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(NN_SIG_LN2_10_HI), fi);
+    __m256 p = _mm256_set1_ps(NN_SIG_EXP_P0);
+    __m256i const nScale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+
+    r = _mm256_mul_ps(_mm256_fnmadd_ps(n, _mm256_set1_ps(NN_SIG_LN2_10_LO), r), _mm256_set1_ps(0.1f));
+
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(NN_SIG_EXP_P1));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(NN_SIG_EXP_P2));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(NN_SIG_EXP_P3));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(NN_SIG_EXP_P4));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(NN_SIG_EXP_P5));
+    p = _mm256_fmadd_ps(_mm256_mul_ps(p, r), r, _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+
+    return _mm256_mul_ps(_mm256_mul_ps(p, _mm256_castsi256_ps(nScale)), _mm256_set1_ps(0.1f));
+}
+
+__attribute__((target("avx2,fma"))) static inline __m256
+Sigmoid8AVX2(__m256 x)
+{
+    __m256 const one = _mm256_set1_ps(1.0f);
+    __m256 const ax = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+    __m256 const x1 = _mm256_mul_ps(_mm256_set1_ps(10.0f), ax);
+    /* (int) x1 reaches 100 just below 10, where sigmoid() reads e[100] = e[99] */
+    __m256 const fi = _mm256_round_ps(_mm256_min_ps(x1, _mm256_set1_ps(100.0f)), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256 const e = ExpTenthAVX2(_mm256_min_ps(fi, _mm256_set1_ps(99.0f)));
+    __m256 r = _mm256_div_ps(one, _mm256_fmadd_ps(e, _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(10.0f), fi), x1), one));
+
+    r = _mm256_blendv_ps(r, _mm256_set1_ps(NN_SIG_TAIL), _mm256_cmp_ps(ax, _mm256_set1_ps(10.0f), _CMP_GE_OQ));
+
+    return _mm256_blendv_ps(r, _mm256_sub_ps(one, r), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+}
+
+__attribute__((target("avx2,fma"))) static void
+SigmoidAVX2(float ar[], unsigned int c, float rBeta)
+{
+    __m256 const x = _mm256_set1_ps(-rBeta);
+    unsigned int i;
+
+    for (i = 0; i + 8 <= c; i += 8)
+        _mm256_storeu_ps(ar + i, Sigmoid8AVX2(_mm256_mul_ps(x, _mm256_loadu_ps(ar + i))));
+
+    if (i < c) {
+        float arTail[8] = {0};
+
+        memcpy(arTail, ar + i, (c - i) * sizeof(float));
+        _mm256_storeu_ps(arTail, Sigmoid8AVX2(_mm256_mul_ps(x, _mm256_loadu_ps(arTail))));
+        memcpy(ar + i, arTail, (c - i) * sizeof(float));
+    }
+}
+
+__attribute__((target("sse2"))) static void
+HiddenLayerSSE2(const float arWeight[], unsigned int cHidden, unsigned int cBatch,
+                const nninput aan[], unsigned int cStride, const unsigned int ac[], float aar[])
+{
+    unsigned int b, j = 0, k;
+
+    for (; j + SSE_BLOCK <= cHidden; j += SSE_BLOCK)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            float *ar = aar + b * cHidden + j;
+            __m128 s0 = _mm_loadu_ps(ar);
+            __m128 s1 = _mm_loadu_ps(ar + 4);
+            __m128 s2 = _mm_loadu_ps(ar + 8);
+            __m128 s3 = _mm_loadu_ps(ar + 12);
+
+            for (k = 0; k < ac[b]; k++) {
+                const float *pr = arWeight + an[k].i * cHidden + j;
+                __m128 const x = _mm_set1_ps(an[k].r);
+
+                s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(pr), x));
+                s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(pr + 4), x));
+                s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(pr + 8), x));
+                s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_loadu_ps(pr + 12), x));
+            }
+
+            _mm_storeu_ps(ar, s0);
+            _mm_storeu_ps(ar + 4, s1);
+            _mm_storeu_ps(ar + 8, s2);
+            _mm_storeu_ps(ar + 12, s3);
+        }
+
+    for (; j + 4 <= cHidden; j += 4)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            __m128 s = _mm_loadu_ps(aar + b * cHidden + j);
+
+            for (k = 0; k < ac[b]; k++)
+                s = _mm_add_ps(s, _mm_mul_ps(_mm_loadu_ps(arWeight + an[k].i * cHidden + j), _mm_set1_ps(an[k].r)));
+
+            _mm_storeu_ps(aar + b * cHidden + j, s);
+        }
+}
+
+__attribute__((target("sse2"))) static inline __m128
+LoadQSSE2(const void *aq, int nBits, size_t i)
+{
+    __m128i x;
+
+    /* sign extend to 32 bits by duplicating and shifting back */
+    if (nBits == 8) {
+        int32_t n;
+
+        memcpy(&n, (const int8_t *)aq + i, sizeof(n));
+        x = _mm_cvtsi32_si128(n);
+        x = _mm_unpacklo_epi8(x, x);
+        x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 24);
+    } else {
+        x = _mm_loadl_epi64((const __m128i *)((const int16_t *)aq + i));
+        x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    }
+
+    return _mm_cvtepi32_ps(x);
+}
+
+__attribute__((target("sse2"))) static void
+HiddenLayerQSSE2(const void *aqWeight, int nBits, unsigned int cHidden, unsigned int cBatch,
+                 const nninput aan[], unsigned int cStride, const unsigned int ac[], float aar[])
+{
+    unsigned int b, j = 0, k;
+
+    for (; j + SSE_BLOCK <= cHidden; j += SSE_BLOCK)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            float *ar = aar + b * cHidden + j;
+            __m128 s0 = _mm_loadu_ps(ar);
+            __m128 s1 = _mm_loadu_ps(ar + 4);
+            __m128 s2 = _mm_loadu_ps(ar + 8);
+            __m128 s3 = _mm_loadu_ps(ar + 12);
+
+            for (k = 0; k < ac[b]; k++) {
+                size_t const iRow = (size_t)an[k].i * cHidden + j;
+                __m128 const x = _mm_set1_ps(an[k].r);
+
+                s0 = _mm_add_ps(s0, _mm_mul_ps(LoadQSSE2(aqWeight, nBits, iRow), x));
+                s1 = _mm_add_ps(s1, _mm_mul_ps(LoadQSSE2(aqWeight, nBits, iRow + 4), x));
+                s2 = _mm_add_ps(s2, _mm_mul_ps(LoadQSSE2(aqWeight, nBits, iRow + 8), x));
+                s3 = _mm_add_ps(s3, _mm_mul_ps(LoadQSSE2(aqWeight, nBits, iRow + 12), x));
+            }
+
+            _mm_storeu_ps(ar, s0);
+            _mm_storeu_ps(ar + 4, s1);
+            _mm_storeu_ps(ar + 8, s2);
+            _mm_storeu_ps(ar + 12, s3);
+        }
+
+    for (; j + 4 <= cHidden; j += 4)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            __m128 s = _mm_loadu_ps(aar + b * cHidden + j);
+
+            for (k = 0; k < ac[b]; k++)
+                s = _mm_add_ps(s, _mm_mul_ps(LoadQSSE2(aqWeight, nBits, (size_t)an[k].i * cHidden + j),
+                                             _mm_set1_ps(an[k].r)));
+
+            _mm_storeu_ps(aar + b * cHidden + j, s);
+        }
+}
+
+__attribute__((target("sse2"))) static void
+OutputLayerSSE2(const neuralnet *pnn, const float ar[], float arOutput[])
+{
+    const float *prWeight = pnn->arOutputWeight;
+    __m128 as[NN_MAX_OUTPUTS];
+    unsigned int i, j;
+
+    for (i = 0; i < pnn->cOutput; i++)
+        as[i] = _mm_setzero_ps();
+
+    for (j = 0; j < pnn->cHiddenPad; j += 8) {
+        __m128 const x0 = _mm_loadu_ps(ar + j);
+        __m128 const x1 = _mm_loadu_ps(ar + j + 4);
+
+        for (i = 0; i < pnn->cOutput; i++, prWeight += 8) {
+            as[i] = _mm_add_ps(as[i], _mm_mul_ps(x0, _mm_load_ps(prWeight)));
+            as[i] = _mm_add_ps(as[i], _mm_mul_ps(x1, _mm_load_ps(prWeight + 4)));
+        }
+    }
+
+    for (i = 0; i < pnn->cOutput; i++) {
+        __m128 s = _mm_add_ps(as[i], _mm_movehl_ps(as[i], as[i]));
+
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        arOutput[i] = pnn->arOutputThreshold[i] + _mm_cvtss_f32(s);
+    }
+}
+
+__attribute__((target("sse2"))) static inline __m128
+SelectSSE2(__m128 f, __m128 a, __m128 b)
+{
+    /* a where f is set, b elsewhere */
+    return _mm_or_ps(_mm_and_ps(f, a), _mm_andnot_ps(f, b));
+}
+
+__attribute__((target("sse2"))) static inline __m128
+ExpTenthSSE2(__m128 fi)
+{
+    /* exp(i / 10) / 10 for the integers i in fi, see neuralnetsimd.h */
+    __m128i const nInt = _mm_cvtps_epi32(_mm_mul_ps(fi, _mm_set1_ps(NN_SIG_LOG2E_10)));
+    __m128 const n = _mm_cvtepi32_ps(nInt);
+    __m128 r = _mm_sub_ps(fi, _mm_mul_ps(n, _mm_set1_ps(NN_SIG_LN2_10_HI)));
+    __m128 p = _mm_set1_ps(NN_SIG_EXP_P0);
+
+    r = _mm_mul_ps(_mm_sub_ps(r, _mm_mul_ps(n, _mm_set1_ps(NN_SIG_LN2_10_LO))), _mm_set1_ps(0.1f));
+
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(NN_SIG_EXP_P1));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(NN_SIG_EXP_P2));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(NN_SIG_EXP_P3));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(NN_SIG_EXP_P4));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(NN_SIG_EXP_P5));
+    p = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, r), r), _mm_add_ps(r, _mm_set1_ps(1.0f)));
+
+    p = _mm_mul_ps(p, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(nInt, _mm_set1_epi32(127)), 23)));
+
+    return _mm_mul_ps(p, _mm_set1_ps(0.1f));
+}
+
+__attribute__((target("sse2"))) static inline __m128
+Sigmoid4SSE2(__m128 x)
+{
+    __m128 const one = _mm_set1_ps(1.0f);
+    __m128 const ax = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+    __m128 const x1 = _mm_mul_ps(_mm_set1_ps(10.0f), ax);
+    /* (int) x1 reaches 100 just below 10, where sigmoid() reads e[100] = e[99] */
+    __m128 const fi = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_min_ps(x1, _mm_set1_ps(100.0f))));
+    __m128 const e = ExpTenthSSE2(_mm_min_ps(fi, _mm_set1_ps(99.0f)));
+    __m128 r = _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(e, _mm_add_ps(_mm_sub_ps(_mm_set1_ps(10.0f), fi), x1))));
+
+    r = SelectSSE2(_mm_cmpge_ps(ax, _mm_set1_ps(10.0f)), _mm_set1_ps(NN_SIG_TAIL), r);
+
+    return SelectSSE2(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(one, r), r);
+}
+
+__attribute__((target("sse2"))) static void
+SigmoidSSE2(float ar[], unsigned int c, float rBeta)
+{
+    __m128 const x = _mm_set1_ps(-rBeta);
+    unsigned int i;
+
+    for (i = 0; i + 4 <= c; i += 4)
+        _mm_storeu_ps(ar + i, Sigmoid4SSE2(_mm_mul_ps(x, _mm_loadu_ps(ar + i))));
+
+    if (i < c) {
+        float arTail[4] = {0};
+
+        memcpy(arTail, ar + i, (c - i) * sizeof(float));
+        _mm_storeu_ps(arTail, Sigmoid4SSE2(_mm_mul_ps(x, _mm_loadu_ps(arTail))));
+        memcpy(ar + i, arTail, (c - i) * sizeof(float));
+    }
+}
+
+static const nnkernel nnkAVX2 = {"avx2", HiddenLayerAVX2, HiddenLayerQAVX2, OutputLayerAVX2, SigmoidAVX2};
+static const nnkernel nnkSSE2 = {"sse2", HiddenLayerSSE2, HiddenLayerQSSE2, OutputLayerSSE2, SigmoidSSE2};
+
+static unsigned long long
+xgetbv0(void)
+{
+    unsigned int eax, edx;
+
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+
+    return ((unsigned long long)edx << 32) | eax;
+}
+
+static int
+HaveAVX2(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int const fNeeded = bit_AVX | bit_FMA | bit_OSXSAVE;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || (ecx & fNeeded) != fNeeded)
+        return FALSE;
+
+    /* the OS must preserve the XMM and YMM state */
+    if ((xgetbv0() & 0x6) != 0x6)
+        return FALSE;
+
+    if (__get_cpuid_max(0, NULL) < 7)
+        return FALSE;
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+    return (ebx & bit_AVX2) != 0;
+}
+
+static int
+HaveSSE2(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & bit_SSE2);
+}
+
+extern unsigned int
+NeuralNetKernelsSSE(const nnkernel *apnnk[2])
+{
+    unsigned int c = 0;
+
+    if (HaveAVX2())
+        apnnk[c++] = &nnkAVX2;
+
+    if (HaveSSE2())
+        apnnk[c++] = &nnkSSE2;
+
+    return c;
+}
+
+#else
+
+extern unsigned int
+NeuralNetKernelsSSE(const nnkernel *apnnk[2])
+{
+    return 0;
+}
+
+#endif
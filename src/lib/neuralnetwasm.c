@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2025 Alessandro Scotti
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * WebAssembly simd128 neural net kernel.
+ *
+ * Unlike x86 there is no run time detection inside a wasm module: this
+ * kernel exists only when the module is built with -msimd128, and the
+ * JavaScript loader picks that module if the browser supports SIMD.
+ */
+
+#include "config.h"
+#include "glib_shim.h"
+#include "neuralnetsimd.h"
+
+#if defined(__wasm_simd128__)
+
+#include <wasm_simd128.h>
+
+/* Number of hidden nodes kept in registers while walking the inputs */
+#define WASM_BLOCK 16
+
+#if NN_HIDDEN_ALIGN != 8
+#error "the output layer kernel expects blocks of 8 hidden nodes"
+#endif
+
+static void
+HiddenLayerWasm(const float arWeight[], unsigned int cHidden, unsigned int cBatch,
+                const nninput aan[], unsigned int cStride, const unsigned int ac[], float aar[])
+{
+    unsigned int b, j = 0, k;
+
+    for (; j + WASM_BLOCK <= cHidden; j += WASM_BLOCK)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            float *ar = aar + b * cHidden + j;
+            v128_t s0 = wasm_v128_load(ar);
+            v128_t s1 = wasm_v128_load(ar + 4);
+            v128_t s2 = wasm_v128_load(ar + 8);
+            v128_t s3 = wasm_v128_load(ar + 12);
+
+            for (k = 0; k < ac[b]; k++) {
+                const float *pr = arWeight + an[k].i * cHidden + j;
+                v128_t const x = wasm_f32x4_splat(an[k].r);
+
+                s0 = wasm_f32x4_add(s0, wasm_f32x4_mul(wasm_v128_load(pr), x));
+                s1 = wasm_f32x4_add(s1, wasm_f32x4_mul(wasm_v128_load(pr + 4), x));
+                s2 = wasm_f32x4_add(s2, wasm_f32x4_mul(wasm_v128_load(pr + 8), x));
+                s3 = wasm_f32x4_add(s3, wasm_f32x4_mul(wasm_v128_load(pr + 12), x));
+            }
+
+            wasm_v128_store(ar, s0);
+            wasm_v128_store(ar + 4, s1);
+            wasm_v128_store(ar + 8, s2);
+            wasm_v128_store(ar + 12, s3);
+        }
+
+    for (; j + 4 <= cHidden; j += 4)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            v128_t s = wasm_v128_load(aar + b * cHidden + j);
+
+            for (k = 0; k < ac[b]; k++)
+                s = wasm_f32x4_add(s, wasm_f32x4_mul(wasm_v128_load(arWeight + an[k].i * cHidden + j),
+                                                     wasm_f32x4_splat(an[k].r)));
+
+            wasm_v128_store(aar + b * cHidden + j, s);
+        }
+}
+
+static inline v128_t
+LoadQWasm(const void *aq, int nBits, size_t i)
+{
+    if (nBits == 8)
+        return wasm_f32x4_convert_i32x4(wasm_i32x4_extend_low_i16x8(wasm_i16x8_load8x8((const int8_t *)aq + i)));
+
+    return wasm_f32x4_convert_i32x4(wasm_i32x4_load16x4((const int16_t *)aq + i));
+}
+
+static void
+HiddenLayerQWasm(const void *aqWeight, int nBits, unsigned int cHidden, unsigned int cBatch,
+                 const nninput aan[], unsigned int cStride, const unsigned int ac[], float aar[])
+{
+    unsigned int b, j = 0, k;
+
+    for (; j + WASM_BLOCK <= cHidden; j += WASM_BLOCK)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            float *ar = aar + b * cHidden + j;
+            v128_t s0 = wasm_v128_load(ar);
+            v128_t s1 = wasm_v128_load(ar + 4);
+            v128_t s2 = wasm_v128_load(ar + 8);
+            v128_t s3 = wasm_v128_load(ar + 12);
+
+            for (k = 0; k < ac[b]; k++) {
+                size_t const iRow = (size_t)an[k].i * cHidden + j;
+                v128_t const x = wasm_f32x4_splat(an[k].r);
+
+                s0 = wasm_f32x4_add(s0, wasm_f32x4_mul(LoadQWasm(aqWeight, nBits, iRow), x));
+                s1 = wasm_f32x4_add(s1, wasm_f32x4_mul(LoadQWasm(aqWeight, nBits, iRow + 4), x));
+                s2 = wasm_f32x4_add(s2, wasm_f32x4_mul(LoadQWasm(aqWeight, nBits, iRow + 8), x));
+                s3 = wasm_f32x4_add(s3, wasm_f32x4_mul(LoadQWasm(aqWeight, nBits, iRow + 12), x));
+            }
+
+            wasm_v128_store(ar, s0);
+            wasm_v128_store(ar + 4, s1);
+            wasm_v128_store(ar + 8, s2);
+            wasm_v128_store(ar + 12, s3);
+        }
+
+    for (; j + 4 <= cHidden; j += 4)
+        for (b = 0; b < cBatch; b++) {
+            const nninput *an = aan + b * cStride;
+            v128_t s = wasm_v128_load(aar + b * cHidden + j);
+
+            for (k = 0; k < ac[b]; k++)
+                s = wasm_f32x4_add(s, wasm_f32x4_mul(LoadQWasm(aqWeight, nBits, (size_t)an[k].i * cHidden + j),
+                                                     wasm_f32x4_splat(an[k].r)));
+
+            wasm_v128_store(aar + b * cHidden + j, s);
+        }
+}
+
+static void
+OutputLayerWasm(const neuralnet *pnn, const float ar[], float arOutput[])
+{
+    const float *prWeight = pnn->arOutputWeight;
+    v128_t as[NN_MAX_OUTPUTS];
+    unsigned int i, j;
+
+    for (i = 0; i < pnn->cOutput; i++)
+        as[i] = wasm_f32x4_splat(0.0f);
+
+    for (j = 0; j < pnn->cHiddenPad; j += 8) {
+        v128_t const x0 = wasm_v128_load(ar + j);
+        v128_t const x1 = wasm_v128_load(ar + j + 4);
+
+        for (i = 0; i < pnn->cOutput; i++, prWeight += 8) {
+            as[i] = wasm_f32x4_add(as[i], wasm_f32x4_mul(x0, wasm_v128_load(prWeight)));
+            as[i] = wasm_f32x4_add(as[i], wasm_f32x4_mul(x1, wasm_v128_load(prWeight + 4)));
+        }
+    }
+
+    for (i = 0; i < pnn->cOutput; i++)
+        arOutput[i] = pnn->arOutputThreshold[i] +
+            (wasm_f32x4_extract_lane(as[i], 0) + wasm_f32x4_extract_lane(as[i], 1)) +
+            (wasm_f32x4_extract_lane(as[i], 2) + wasm_f32x4_extract_lane(as[i], 3));
+}
+
+static inline v128_t
+ExpTenthWasm(v128_t fi)
+{
+    /* exp(i / 10) / 10 for the integers i in fi, see neuralnetsimd.h */
+    v128_t const n = wasm_f32x4_nearest(wasm_f32x4_mul(fi, wasm_f32x4_splat(NN_SIG_LOG2E_10)));
+    v128_t r = wasm_f32x4_sub(fi, wasm_f32x4_mul(n, wasm_f32x4_splat(NN_SIG_LN2_10_HI)));
+    v128_t p = wasm_f32x4_splat(NN_SIG_EXP_P0);
+    v128_t const nScale = wasm_i32x4_shl(wasm_i32x4_add(wasm_i32x4_trunc_sat_f32x4(n), wasm_i32x4_splat(127)), 23);
+
+    r = wasm_f32x4_mul(wasm_f32x4_sub(r, wasm_f32x4_mul(n, wasm_f32x4_splat(NN_SIG_LN2_10_LO))), wasm_f32x4_splat(0.1f));
+
+    p = wasm_f32x4_add(wasm_f32x4_mul(p, r), wasm_f32x4_splat(NN_SIG_EXP_P1));
+    p = wasm_f32x4_add(wasm_f32x4_mul(p, r), wasm_f32x4_splat(NN_SIG_EXP_P2));
+    p = wasm_f32x4_add(wasm_f32x4_mul(p, r), wasm_f32x4_splat(NN_SIG_EXP_P3));
+    p = wasm_f32x4_add(wasm_f32x4_mul(p, r), wasm_f32x4_splat(NN_SIG_EXP_P4));
+    p = wasm_f32x4_add(wasm_f32x4_mul(p, r), wasm_f32x4_splat(NN_SIG_EXP_P5));
+    p = wasm_f32x4_add(wasm_f32x4_mul(wasm_f32x4_mul(p, r), r), wasm_f32x4_add(r, wasm_f32x4_splat(1.0f)));
+
+    return wasm_f32x4_mul(wasm_f32x4_mul(p, nScale), wasm_f32x4_splat(0.1f));
+}
+
+static inline v128_t
+Sigmoid4Wasm(v128_t x)
+{
+    v128_t const one = wasm_f32x4_splat(1.0f);
+    v128_t const ax = wasm_f32x4_abs(x);
+    v128_t const x1 = wasm_f32x4_mul(wasm_f32x4_splat(10.0f), ax);
+    /* (int) x1 reaches 100 just below 10, where sigmoid() reads e[100] = e[99] */
+    v128_t const fi = wasm_f32x4_trunc(wasm_f32x4_pmin(x1, wasm_f32x4_splat(100.0f)));
+    v128_t const e = ExpTenthWasm(wasm_f32x4_pmin(fi, wasm_f32x4_splat(99.0f)));
+    v128_t r = wasm_f32x4_div(one, wasm_f32x4_add(one, wasm_f32x4_mul(e, wasm_f32x4_add(wasm_f32x4_sub(wasm_f32x4_splat(10.0f), fi), x1))));
+
+    r = wasm_v128_bitselect(wasm_f32x4_splat(NN_SIG_TAIL), r, wasm_f32x4_ge(ax, wasm_f32x4_splat(10.0f)));
+
+    return wasm_v128_bitselect(wasm_f32x4_sub(one, r), r, wasm_f32x4_lt(x, wasm_f32x4_splat(0.0f)));
+}
+
+static void
+SigmoidWasm(float ar[], unsigned int c, float rBeta)
+{
+    v128_t const x = wasm_f32x4_splat(-rBeta);
+    unsigned int i;
+
+    for (i = 0; i + 4 <= c; i += 4)
+        wasm_v128_store(ar + i, Sigmoid4Wasm(wasm_f32x4_mul(x, wasm_v128_load(ar + i))));
+
+    if (i < c) {
+        float arTail[4] = {0};
+
+        memcpy(arTail, ar + i, (c - i) * sizeof(float));
+        wasm_v128_store(arTail, Sigmoid4Wasm(wasm_f32x4_mul(x, wasm_v128_load(arTail))));
+        memcpy(ar + i, arTail, (c - i) * sizeof(float));
+    }
+}
+
+static const nnkernel nnkWasm = {"wasm-simd128", HiddenLayerWasm, HiddenLayerQWasm, OutputLayerWasm, SigmoidWasm};
+
+extern const nnkernel *
+NeuralNetKernelWasm(void)
+{
+    return &nnkWasm;
+}
+
+#else
+
+extern const nnkernel *
+NeuralNetKernelWasm(void)
+{
+    return NULL;
+}
+
+#endif
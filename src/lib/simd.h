@@ -18,8 +18,32 @@
 #ifndef SIMD_H
 #define SIMD_H
 
+#include <stdlib.h>
+
+/* Stack and static data is aligned for SSE / wasm simd128 (16 bytes).
+ * Heap blocks from sse_malloc() are aligned for AVX (32 bytes), so that
+ * the neural net weight rows can be loaded with aligned 256-bit loads
+ * whatever kernel is picked at run time. */
+#define ALIGN_SIZE 16
+#define ALIGN_SIZE_MALLOC 32
+
+#if defined(__GNUC__)
+#define SSE_ALIGN(D) D __attribute__((aligned(ALIGN_SIZE)))
+#else
 #define SSE_ALIGN(D) D
-#define sse_malloc malloc
+#endif
+
+static inline void *
+sse_malloc(size_t size)
+{
+    void *p;
+
+    if (posix_memalign(&p, ALIGN_SIZE_MALLOC, size ? size : ALIGN_SIZE_MALLOC))
+        return NULL;
+
+    return p;
+}
+
 #define sse_free free
 #define SIMD_STACKALIGN
 #define SIMD_AVX_STACKALIGN
@@ -34,7 +34,11 @@ typedef struct Task {
 typedef struct {
     int id;
     move *aMoves;
+    unsigned int *aMoveIndex;   /* aMoves by key, see SaveMoves() */
+    unsigned int nMoveIndexStamp;
     NNState *pnnState;
+    cachecounts *pcc;           /* see EvalCacheCounts() */
+    racehalf *aRaceHalf;        /* see RaceHalfActive() */
 } ThreadLocalData;
 
 typedef struct {
@@ -61,6 +65,7 @@ extern void MT_Close(void);
 extern void MT_CloseThreads(void);
 extern void CloseThread(void *unused);
 extern ThreadLocalData *MT_CreateThreadLocalData(int id);
+extern void MT_SumCacheCounts(cachecounts * pcc, int fReset);
 
 extern ThreadData td;
 
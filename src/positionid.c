@@ -452,24 +452,24 @@ PositionF(unsigned int fBits, unsigned int n, unsigned int r)
 extern unsigned int
 PositionBearoff(const unsigned int anBoard[], unsigned int nPoints, unsigned int nChequers)
 {
-    unsigned int i, fBits, j;
+    unsigned int i, n, nID;
 
     if (nPoints == 0) {
         g_assert_not_reached();
         return 0;
     }
 
-    for (j = nPoints - 1, i = 0; i < nPoints; i++)
-        j += anBoard[i];
+    /* The bit of point i in the pattern of PositionF() is bit
+     * nPoints - 1 - i + n, n the chequers from point i up, and it is the
+     * (nPoints - i)-th highest one; the bits below nPoints are worth 0 */
 
-    fBits = 1u << j;
+    for (nID = n = 0, i = nPoints; i-- > 0;)
+        if ((n += anBoard[i]))
+            nID += Combination(nPoints - 1 - i + n, nPoints - i);
 
-    for (i = 0; i < nPoints - 1; i++) {
-        j -= anBoard[i] + 1;
-        fBits |= (1u << j);
-    }
+    g_assert(n <= nChequers);
 
-    return PositionF(fBits, nChequers + nPoints, nPoints);
+    return nID;
 }
 
 static unsigned int
@@ -222,8 +222,8 @@ BasicCubefulRollout(unsigned int aanBoard[][2][25],
     float aaar[6][6][NUM_ROLLOUT_OUTPUTS];
 #endif
 
-    evalcontext ecCubeless0ply = {FALSE, 0, FALSE, TRUE, 0.0};
-    evalcontext ecCubeful0ply = {TRUE, 0, FALSE, TRUE, 0.0};
+    evalcontext ecCubeless0ply = {FALSE, 0, FALSE, TRUE, FALSE, 0.0};
+    evalcontext ecCubeful0ply = {TRUE, 0, FALSE, TRUE, FALSE, 0.0};
 
     /* local pointers to the eval contexts to use */
     evalcontext *pecCube[2], *pecChequer[2];
@@ -1596,7 +1596,8 @@ getResignEquities(float arResign[NUM_ROLLOUT_OUTPUTS], cubeinfo *pci, int nResig
 }
 
 extern int
-ScoreMoveRollout(move **ppm, cubeinfo **ppci, int cMoves, rolloutprogressfunc *pfRolloutProgress, void *pUserData)
+ScoreMoveRollout(move **ppm, moverollout **ppmr, cubeinfo **ppci, int cMoves, rolloutprogressfunc *pfRolloutProgress,
+                 void *pUserData)
 {
     int fCubeDecTop = TRUE;
     int i;
@@ -1615,8 +1616,8 @@ ScoreMoveRollout(move **ppm, cubeinfo **ppci, int cMoves, rolloutprogressfunc *p
     for (i = 0; i < cMoves; ++i) {
         apBoard[i] = (ConstTanBoard)(anBoard + i);
         apOutput[i] = &ppm[i]->arEvalMove;
-        apStdDev[i] = &ppm[i]->arEvalStdDev;
-        apes[i] = &ppm[i]->esMove;
+        apStdDev[i] = &ppmr[i]->arEvalStdDev;
+        apes[i] = &ppmr[i]->esMove;
         apci[i] = aci + i;
         memcpy(aci + i, ppci[i], sizeof(cubeinfo));
         apCubeDecTop[i] = &fCubeDecTop;
@@ -1659,6 +1660,7 @@ ScoreMoveRollout(move **ppm, cubeinfo **ppci, int cMoves, rolloutprogressfunc *p
             ppm[i]->rScore = ppm[i]->arEvalMove[OUTPUT_EQUITY];
 
         ppm[i]->rScore2 = ppm[i]->arEvalMove[OUTPUT_EQUITY];
+        ppm[i]->etMove = apes[i]->et;
     }
 
     return 0;
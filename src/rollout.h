@@ -121,7 +121,7 @@ extern void
  getResignEquities(float arResign[NUM_ROLLOUT_OUTPUTS], cubeinfo * pci, int nResigned, float *prBefore, float *prAfter);
 
 extern int
-ScoreMoveRollout(move ** ppm, cubeinfo ** ppci, int cMoves,
+ScoreMoveRollout(move ** ppm, moverollout ** ppmr, cubeinfo ** ppci, int cMoves,
                  rolloutprogressfunc * pfRolloutProgress, void *pUserData);
 
 extern void RolloutLoopMT(void *unused);
@@ -54,21 +54,21 @@ rngcontext *rngctxRollout = NULL;
 // Global used by rollout.c instead of the passed parameter
 rolloutcontext rcRollout = {
     {/* player 0/1 cube decision */
-     {TRUE, 2, TRUE, TRUE, 0.0},
-     {TRUE, 2, TRUE, TRUE, 0.0}},
+     {TRUE, 2, TRUE, TRUE, FALSE, 0.0},
+     {TRUE, 2, TRUE, TRUE, FALSE, 0.0}},
     {/* player 0/1 chequerplay */
-     {TRUE, 0, TRUE, TRUE, 0.0},
-     {TRUE, 0, TRUE, TRUE, 0.0}},
+     {TRUE, 0, TRUE, TRUE, FALSE, 0.0},
+     {TRUE, 0, TRUE, TRUE, FALSE, 0.0}},
 
     {/* player 0/1 late cube decision */
-     {TRUE, 2, TRUE, TRUE, 0.0},
-     {TRUE, 2, TRUE, TRUE, 0.0}},
+     {TRUE, 2, TRUE, TRUE, FALSE, 0.0},
+     {TRUE, 2, TRUE, TRUE, FALSE, 0.0}},
     {/* player 0/1 late chequerplay */
-     {TRUE, 0, TRUE, TRUE, 0.0},
-     {TRUE, 0, TRUE, TRUE, 0.0}},
+     {TRUE, 0, TRUE, TRUE, FALSE, 0.0},
+     {TRUE, 0, TRUE, TRUE, FALSE, 0.0}},
     /* truncation point cube and chequerplay */
-    {TRUE, 2, TRUE, TRUE, 0.0},
-    {TRUE, 2, TRUE, TRUE, 0.0},
+    {TRUE, 2, TRUE, TRUE, FALSE, 0.0},
+    {TRUE, 2, TRUE, TRUE, FALSE, 0.0},
 
     /* move filters */
     {MOVEFILTER_NORMAL, MOVEFILTER_NORMAL},
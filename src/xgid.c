@@ -196,6 +196,7 @@ int evaluatePosition(const matchstate *pms, int nPlies)
     ec.fUsePrune = FALSE;
     ec.fDeterministic = TRUE;
     ec.rNoise = 0.0f; // No noise
+    ec.fBearoffPlay = FALSE;
 
     float arOutput[NUM_OUTPUTS];
 
@@ -235,7 +236,7 @@ int evaluatePositionXgid(const char *xgid, int nPlies)
     return evaluatePosition(&ms, nPlies);
 }
 
-int findBestMoves(movelist *pml, const matchstate *pms, int nPlies)
+int findBestMoves(movelist *pml, const matchstate *pms, int nPlies, int fBearoffPlay)
 {
     // Get dice values
     int nDice0 = pms->anDice[0];
@@ -260,6 +261,7 @@ int findBestMoves(movelist *pml, const matchstate *pms, int nPlies)
     ec.fUsePrune = FALSE;
     ec.fDeterministic = TRUE;
     ec.rNoise = 0.0f; // No noise
+    ec.fBearoffPlay = fBearoffPlay; // Table plays in one-sided bearoffs, see EvalBearoffPlays()
 
     movefilter aamf[MAX_FILTER_PLIES][MAX_FILTER_PLIES] = MOVEFILTER_LARGE;
     // MOVEFILTER_TINY, MOVEFILTER_NARROW, MOVEFILTER_NORMAL, MOVEFILTER_LARGE, MOVEFILTER_HUGE
@@ -277,26 +279,26 @@ int findCubeDecision(cubedecision *pcd, float arEquity[NUM_CUBEFUL_OUTPUTS], flo
     cubeinfo ci;
     evalsetup esSupremo = {
         EVAL_EVAL,                       // evaltype
-        {TRUE, nPlies, TRUE, TRUE, 0.0}, // evalcontext
+        {TRUE, nPlies, TRUE, TRUE, FALSE, 0.0}, // evalcontext
         {                                // rolloutcontext
          {
-             {FALSE, 2, TRUE, TRUE, 0.0}, // player 0 cube decision
-             {FALSE, 2, TRUE, TRUE, 0.0}  // player 1 cube decision
+             {FALSE, 2, TRUE, TRUE, FALSE, 0.0}, // player 0 cube decision
+             {FALSE, 2, TRUE, TRUE, FALSE, 0.0}  // player 1 cube decision
          },
          {
-             {FALSE, 0, TRUE, TRUE, 0.0}, // player 0 chequerplay
-             {FALSE, 0, TRUE, TRUE, 0.0}  // player 1 chequerplay
+             {FALSE, 0, TRUE, TRUE, FALSE, 0.0}, // player 0 chequerplay
+             {FALSE, 0, TRUE, TRUE, FALSE, 0.0}  // player 1 chequerplay
          },
          {
-             {FALSE, 2, TRUE, TRUE, 0.0}, // p 0 late cube decision
-             {FALSE, 2, TRUE, TRUE, 0.0}  // p 1 late cube decision
+             {FALSE, 2, TRUE, TRUE, FALSE, 0.0}, // p 0 late cube decision
+             {FALSE, 2, TRUE, TRUE, FALSE, 0.0}  // p 1 late cube decision
          },
          {
-             {FALSE, 0, TRUE, TRUE, 0.0}, // p 0 late chequerplay
-             {FALSE, 0, TRUE, TRUE, 0.0}  // p 1 late chequerplay
+             {FALSE, 0, TRUE, TRUE, FALSE, 0.0}, // p 0 late chequerplay
+             {FALSE, 0, TRUE, TRUE, FALSE, 0.0}  // p 1 late chequerplay
          },
-         {FALSE, 2, TRUE, TRUE, 0.0}, // truncate cube decision
-         {FALSE, 2, TRUE, TRUE, 0.0}, // truncate chequerplay
+         {FALSE, 2, TRUE, TRUE, FALSE, 0.0}, // truncate cube decision
+         {FALSE, 2, TRUE, TRUE, FALSE, 0.0}, // truncate chequerplay
          {MOVEFILTER_NORMAL, MOVEFILTER_NORMAL},
          {MOVEFILTER_NORMAL, MOVEFILTER_NORMAL},
          FALSE,     // cubeful
@@ -344,7 +346,7 @@ int findCubeDecision(cubedecision *pcd, float arEquity[NUM_CUBEFUL_OUTPUTS], flo
     return 0;
 }
 
-int findBestAction(PlayerActionInfo *ppai, const char *xgid, int nPlies)
+int findBestAction(PlayerActionInfo *ppai, const char *xgid, int nPlies, int fBearoffPlay)
 {
     matchstate ms;
 
@@ -372,7 +374,7 @@ int findBestAction(PlayerActionInfo *ppai, const char *xgid, int nPlies)
         // Pick the best move
         movelist ml;
 
-        res = findBestMoves(&ml, &ms, nPlies);
+        res = findBestMoves(&ml, &ms, nPlies, fBearoffPlay);
 
         if (res < 0) {
             printf("findBestMoves() error: %d\n", res);
@@ -394,7 +396,7 @@ int findBestAction(PlayerActionInfo *ppai, const char *xgid, int nPlies)
 
             memcpy(pm->anMove, m->anMove, sizeof(pm->anMove));
             memcpy(pm->arEval, m->arEvalMove, sizeof(pm->arEval));
-            memcpy(pm->arEvalStdDev, m->arEvalStdDev, sizeof(pm->arEvalStdDev));
+            memset(pm->arEvalStdDev, 0, sizeof(pm->arEvalStdDev));  /* not a rollout */
         }
     }
 
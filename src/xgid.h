@@ -65,11 +65,11 @@ extern int getCubeInfoFromMatchState(cubeinfo *pci, const matchstate *pms);
 extern int getCubeInfoFromMatchStateWithBeavers(cubeinfo *pci, const matchstate *pms, int nBeavers);
 extern int evaluatePosition(const matchstate *pms, int nPlies);
 extern int evaluatePositionXgid(const char *xgid, int nPlies);
-extern int findBestMoves(movelist *pml, const matchstate *pms, int nPlies);
+extern int findBestMoves(movelist *pml, const matchstate *pms, int nPlies, int fBearoffPlay);
 extern int findCubeDecision(cubedecision *pcd, float arEquity[NUM_CUBEFUL_OUTPUTS], float aarOutput[2][NUM_ROLLOUT_OUTPUTS], const matchstate *pms, int nPlies);
 
 extern PlayerAction getActionFromCubeDecision(cubedecision cd, const matchstate *pms);
 
-int findBestAction(PlayerActionInfo *ppai, const char *xgid, int nPlies);
+int findBestAction(PlayerActionInfo *ppai, const char *xgid, int nPlies, int fBearoffPlay);
 
 #endif // XGID_H
\ No newline at end of file
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2025 Alessandro Scotti
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark of the replacement policy of the evaluation cache, for
+ * tuning CACHE_PLY_AGE (see cache.h).  The positions of random games
+ * are analysed, a cube decision and a chequer play, at 2 and then 3
+ * plies:
+ *
+ * - each one from an empty cache, the reference
+ * - all of them in order and then again in reverse order, keeping the
+ *   cache, which is what the policy is for
+ *
+ * It prints the wall times, the hit rates of the evaluation cache by
+ * plies of the lookups in the second run, and how many of its analyses
+ * differ from the reference: there must be none, whatever the policy.
+ *
+ * "make bench" runs it built with CACHE_PLY_AGE and with BENCH_AGE,
+ * 0 (the policy of gnubg) unless given.
+ *
+ * The arguments are the number of positions (default 30, which takes
+ * a few minutes) and the size of the cache, as for SetEvalCacheSize()
+ * (default 1).
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "api.h"
+#include "backgammon.h"
+#include "eval.h"
+#include "positionid.h"
+
+static unsigned long long nRandom = 0x2545f4914f6cdd1dULL;
+
+static unsigned int
+Random(unsigned int n)
+{
+    nRandom = nRandom * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned int)(nRandom >> 33) % n;
+}
+
+static double
+Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* The positions of random games, from the side on roll, and its roll */
+static void
+RandomGames(TanBoard anBoard[], int anDice[][2], unsigned int cPositions)
+{
+    unsigned int c = 0;
+
+    while (c < cPositions) {
+        TanBoard an = {
+            {0, 0, 0, 0, 0, 5, 0, 3, 0, 0, 0, 0, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0},
+            {0, 0, 0, 0, 0, 5, 0, 3, 0, 0, 0, 0, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0}
+        };
+
+        while (c < cPositions && ClassifyPosition((ConstTanBoard)an, VARIATION_STANDARD) != CLASS_OVER) {
+            movelist ml;
+
+            memcpy(anBoard[c], an, sizeof(TanBoard));
+            anDice[c][0] = (int)Random(6) + 1;
+            anDice[c][1] = (int)Random(6) + 1;
+
+            if (GenerateMoves(&ml, (ConstTanBoard)an, anDice[c][0], anDice[c][1], FALSE))
+                PositionFromKey(an, &ml.amMoves[Random(ml.cMoves)].key);
+            SwapSides(an);
+            c++;
+        }
+    }
+}
+
+/* What the analysis of a position gives */
+typedef struct {
+    float rCube;                /* cubeful equity */
+    positionkey key;            /* best move */
+    float rScore;
+} analysis;
+
+static void
+Analyse(analysis *pa, const TanBoard anBoard, const int anDice[2], int nPlies)
+{
+    evalcontext ec = { TRUE, (unsigned int)nPlies, TRUE, TRUE, FALSE, 0.0f };
+    float ar[NUM_ROLLOUT_OUTPUTS];
+    cubeinfo ci;
+    movelist ml;
+
+    SetCubeInfoMoney(&ci, 1, -1, 0, TRUE, FALSE, VARIATION_STANDARD);
+
+    if (GeneralEvaluationE(ar, anBoard, &ci, &ec) < 0 ||
+        FindnSaveBestMoves(&ml, anDice[0], anDice[1], anBoard, NULL, 0.0f, &ci, &ec, defaultFilters) < 0) {
+        printf("evaluation failed\n");
+        exit(1);
+    }
+    pa->rCube = ar[OUTPUT_CUBEFUL_EQUITY];
+
+    if (ml.cMoves) {
+        CopyKey(ml.amMoves[0].key, pa->key);
+        pa->rScore = ml.amMoves[0].rScore;
+        free(ml.amMoves);
+    } else {
+        memset(&pa->key, 0, sizeof(pa->key));
+        pa->rScore = 0.0f;
+    }
+}
+
+static void
+Bench(TanBoard anBoard[], int anDice[][2], unsigned int cPositions, int nPlies)
+{
+    analysis *aa = malloc(cPositions * sizeof(*aa));
+    unsigned long long aan[CACHE_COUNT_PLIES][N_CACHE_COUNTS] = { {0} };
+    unsigned long long cLookups = 0, cHits = 0;
+    unsigned int cDiffer = 0;
+    float rMax = 0.0f;
+    cachecounts cc;
+    double rTime, rTimeKept;
+    unsigned int i, n;
+    int j, k, l;
+
+    if (!aa)
+        exit(1);
+
+    rTime = Now();
+    for (i = 0; i < cPositions; i++) {
+        EvalCacheFlush();
+        Analyse(aa + i, (ConstTanBoard)anBoard[i], anDice[i], nPlies);
+    }
+    rTime = Now() - rTime;
+
+    EvalCacheFlush();
+    EvalCacheCounts(&cc, TRUE);
+
+    rTimeKept = Now();
+    for (n = 0; n < 2 * cPositions; n++) {
+        /* in order, then in reverse order */
+        unsigned int const iPos = n < cPositions ? n : 2 * cPositions - 1 - n;
+        analysis a;
+
+        Analyse(&a, (ConstTanBoard)anBoard[iPos], anDice[iPos], nPlies);
+
+        if (a.rCube != aa[iPos].rCube || a.rScore != aa[iPos].rScore || !EqualKeys(a.key, aa[iPos].key)) {
+            cDiffer++;
+            rMax = MAX(rMax, MAX(fabsf(a.rCube - aa[iPos].rCube), fabsf(a.rScore - aa[iPos].rScore)));
+        }
+    }
+    rTimeKept = Now() - rTimeKept;
+
+    EvalCacheCounts(&cc, TRUE);
+    for (j = 0; j < N_CLASSES; j++)
+        for (k = 0; k < CACHE_COUNT_PLIES; k++)
+            for (l = 0; l < N_CACHE_COUNTS; l++)
+                aan[k][l] += cc.aac[0][j][k][l];
+
+    for (k = 0; k < CACHE_COUNT_PLIES; k++) {
+        cLookups += aan[k][CACHE_COUNT_LOOKUP];
+        cHits += aan[k][CACHE_COUNT_HIT];
+    }
+
+    printf("%d plies: %.3fs from empty caches, %.3fs twice in a kept one, hits %llu of %llu (%.2f%%)", nPlies,
+           rTime, rTimeKept, cHits, cLookups, cLookups ? 100.0 * cHits / cLookups : 0.0);
+    for (k = 0; k < CACHE_COUNT_PLIES; k++)
+        if (aan[k][CACHE_COUNT_LOOKUP])
+            printf(", %d-ply %.2f%%", k, 100.0 * aan[k][CACHE_COUNT_HIT] / aan[k][CACHE_COUNT_LOOKUP]);
+    printf("\n  %u of %u analyses differ from an empty cache", cDiffer, 2 * cPositions);
+    if (cDiffer)
+        printf(", by up to %g", rMax);
+    printf("\n");
+
+    free(aa);
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned int const cPositions = argc > 1 ? (unsigned int)atoi(argv[1]) : 30;
+    unsigned int const nSize = argc > 2 ? (unsigned int)atoi(argv[2]) : 1;
+    TanBoard *anBoard = malloc(cPositions * sizeof(*anBoard));
+    int (*anDice)[2] = malloc(cPositions * sizeof(*anDice));
+    int nEntries;
+
+    if (!anBoard || !anDice || init() < 0)
+        return 1;
+
+    if ((nEntries = SetEvalCacheSize(nSize, CACHE_LAYOUT_FULL)) < 0) {
+        printf("cannot size the cache\n");
+        return 1;
+    }
+
+    RandomGames(anBoard, anDice, cPositions);
+
+    printf("CACHE_PLY_AGE %d, %d entries, %u positions\n", CACHE_PLY_AGE, nEntries, cPositions);
+    Bench(anBoard, anDice, cPositions, 2);
+    Bench(anBoard, anDice, cPositions, 3);
+
+    shutdown();
+    free(anBoard);
+    free(anDice);
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 1998-2003 Gary Wong <gtw@gnu.org>
+ * Copyright (C) 2003-2021 the AUTHORS
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * GenerateMoves() as it was in eval.c before it worked on the position
+ * key: a recursion per chequer moved on a copy of the board, with the
+ * duplicate moves found by a linear search of the list.  Slow, but
+ * simple enough to be the reference for the generators of eval.c.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "backgammon.h"
+#include "movegen_ref.h"
+#include "positionid.h"
+
+static void
+RefSaveMoves(movelist * pml, unsigned int cMoves, unsigned int cPip, int anMoves[], const TanBoard anBoard, int fPartial)
+{
+    unsigned int i, j;
+    move *pm;
+    positionkey key;
+
+    if (fPartial) {
+        /* Save all moves, even incomplete ones */
+        if (cMoves > pml->cMaxMoves)
+            pml->cMaxMoves = cMoves;
+
+        if (cPip > pml->cMaxPips)
+            pml->cMaxPips = cPip;
+    } else {
+        /* Save only legal moves: if the current move moves plays less
+         * chequers or pips than those already found, it is illegal; if
+         * it plays more, the old moves are illegal. */
+        if (cMoves < pml->cMaxMoves || cPip < pml->cMaxPips)
+            return;
+
+        if (cMoves > pml->cMaxMoves || cPip > pml->cMaxPips)
+            pml->cMoves = 0;
+
+        pml->cMaxMoves = cMoves;
+        pml->cMaxPips = cPip;
+    }
+
+    PositionKey(anBoard, &key);
+
+    for (i = 0; i < pml->cMoves; i++) {
+
+        pm = &(pml->amMoves[i]);
+
+        if (EqualKeys(key, pm->key)) {
+            if (cMoves > pm->cMoves || cPip > pm->cPips) {
+                for (j = 0; j < cMoves * 2; j++)
+                    pm->anMove[j] = anMoves[j] > -1 ? anMoves[j] : -1;
+
+                if (cMoves < 4)
+                    pm->anMove[cMoves * 2] = -1;
+
+                pm->cMoves = cMoves;
+                pm->cPips = cPip;
+            }
+
+            return;
+        }
+    }
+
+    pm = pml->amMoves + pml->cMoves;
+
+    for (i = 0; i < cMoves * 2; i++)
+        pm->anMove[i] = anMoves[i] > -1 ? anMoves[i] : -1;
+
+    if (cMoves < 4)
+        pm->anMove[cMoves * 2] = -1;
+
+    CopyKey(key, pm->key);
+
+    pm->cMoves = cMoves;
+    pm->cPips = cPip;
+
+    pml->cMoves++;
+
+    g_assert(pml->cMoves < MAX_INCOMPLETE_MOVES);
+}
+
+static int
+RefLegalMove(const TanBoard anBoard, int iSrc, int nPips)
+{
+
+    int nBack;
+    const int iDest = iSrc - nPips;
+
+    if (iDest >= 0) { /* Here we can do the Chris rule check */
+        return (anBoard[0][23 - iDest] < 2);
+    }
+    /* otherwise, attempting to bear off */
+
+    for (nBack = 24; nBack > 0; nBack--)
+        if (anBoard[1][nBack] > 0)
+            break;
+
+    return (nBack <= 5 && (iSrc == nBack || iDest == -1));
+}
+
+static int
+RefGenerateMovesSub(movelist * pml, int anRoll[], int nMoveDepth,
+                    int iPip, int cPip, const TanBoard anBoard, int anMoves[], int fPartial)
+{
+    int i, fUsed = 0;
+    TanBoard anBoardNew;
+
+    if (nMoveDepth > 3 || !anRoll[nMoveDepth])
+        return TRUE;
+
+    if (anBoard[1][24]) { /* on bar */
+        if (anBoard[0][anRoll[nMoveDepth] - 1] >= 2)
+            return TRUE;
+
+        anMoves[nMoveDepth * 2] = 24;
+        anMoves[nMoveDepth * 2 + 1] = 24 - anRoll[nMoveDepth];
+
+        memcpy(anBoardNew, anBoard, sizeof(anBoardNew));
+
+        ApplySubMove(anBoardNew, 24, anRoll[nMoveDepth], TRUE);
+
+        if (RefGenerateMovesSub(pml, anRoll, nMoveDepth + 1, 23, cPip + anRoll[nMoveDepth], (ConstTanBoard)anBoardNew, anMoves, fPartial))
+            RefSaveMoves(pml, nMoveDepth + 1, cPip + anRoll[nMoveDepth], anMoves, (ConstTanBoard)anBoardNew, fPartial);
+
+        return fPartial;
+    } else {
+        for (i = iPip; i >= 0; i--)
+            if (anBoard[1][i] && RefLegalMove(anBoard, i, anRoll[nMoveDepth])) {
+                anMoves[nMoveDepth * 2] = i;
+                anMoves[nMoveDepth * 2 + 1] = i - anRoll[nMoveDepth];
+
+                memcpy(anBoardNew, anBoard, sizeof(anBoardNew));
+
+                ApplySubMove(anBoardNew, i, anRoll[nMoveDepth], TRUE);
+
+                if (RefGenerateMovesSub(pml, anRoll, nMoveDepth + 1,
+                                        anRoll[0] == anRoll[1] ? i : 23,
+                                        cPip + anRoll[nMoveDepth], (ConstTanBoard)anBoardNew, anMoves, fPartial))
+                    RefSaveMoves(pml, nMoveDepth + 1, cPip + anRoll[nMoveDepth], anMoves, (ConstTanBoard)anBoardNew, fPartial);
+
+                fUsed = 1;
+            }
+    }
+
+    return !fUsed || fPartial;
+}
+
+extern int
+RefGenerateMoves(movelist * pml, move amMoves[], const TanBoard anBoard, int n0, int n1, int fPartial)
+{
+
+    int anRoll[4], anMoves[8];
+    anRoll[0] = n0;
+    anRoll[1] = n1;
+
+    anRoll[2] = anRoll[3] = ((n0 == n1) ? n0 : 0);
+
+    pml->cMoves = pml->cMaxMoves = pml->cMaxPips = pml->iMoveBest = 0;
+    pml->amMoves = amMoves;
+    RefGenerateMovesSub(pml, anRoll, 0, 23, 0, anBoard, anMoves, fPartial);
+
+    if (anRoll[0] != anRoll[1]) {
+        swap(anRoll, anRoll + 1);
+
+        RefGenerateMovesSub(pml, anRoll, 0, 23, 0, anBoard, anMoves, fPartial);
+    }
+
+    return pml->cMoves;
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2025 Alessandro Scotti
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOVEGEN_REF_H
+#define MOVEGEN_REF_H
+
+#include "eval.h"
+
+/* The recursive move generator that GenerateMoves() replaced, kept as
+ * the reference for its tests; the moves are stored in amMoves[], which
+ * must hold MAX_INCOMPLETE_MOVES of them */
+extern int RefGenerateMoves(movelist * pml, move amMoves[], const TanBoard anBoard, int n0, int n1, int fPartial);
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2025 Alessandro Scotti
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Stress test of CacheLookupWithLocking() and CacheAddWithLocking():
+ * 8 and then 16 threads look up random keys out of 4096 in a cache of
+ * 1024 entries, and add each one they miss.  The outputs stored with a
+ * key are a function of the key, so a hit with any other outputs was
+ * torn by a concurrent write, and there must be none.  Both layouts are
+ * tested; the outputs of the compact one are only within its rounding.
+ *
+ * The argument is the number of lookups of each thread (default 1M).
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cache.h"
+
+#define N_KEYS 4096
+#define CACHE_SIZE 1024
+
+/* largest rounding of the compact layout, see cache.c */
+#define COMPACT_ERROR (0.5f / 65535.0f + 1e-7f)
+
+typedef struct {
+    evalCache *pc;
+    float rError;               /* largest difference of a good hit */
+    unsigned long cLookups;
+    unsigned long long nRandom;
+    unsigned long cHits, cTorn;
+} stressthread;
+
+static uint64_t
+Mix(uint64_t n)
+{
+    n = (n ^ (n >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    n = (n ^ (n >> 27)) * 0x94d049bb133111ebULL;
+    return n ^ (n >> 31);
+}
+
+/* Key and outputs of key number k: probabilities in [0, 1] and an
+ * equity in [-4, 4] */
+static void
+MakeEntry(cacheNodeDetail * e, unsigned int k)
+{
+    uint64_t n = Mix(k);
+    int i;
+
+    for (i = 0; i < 7; i++)
+        e->key.data[i] = (unsigned int)Mix(n + i);
+    e->nEvalContext = (int)(k & 7);
+
+    for (i = 0; i < 5; i++)
+        e->ar[i] = (float)((n >> (i * 12)) & 0xfff) / 4095.0f;
+    e->ar[5] = (float)((n >> 60) & 0xf) / 2.0f - 4.0f;
+}
+
+static void *
+Stress(void *p)
+{
+    stressthread *pst = p;
+    unsigned long i;
+
+    for (i = 0; i < pst->cLookups; i++) {
+        cacheNodeDetail e;
+        float arOut[5], rCubeful;
+        unsigned int l;
+        int j;
+
+        pst->nRandom = pst->nRandom * 6364136223846793005ULL + 1442695040888963407ULL;
+        MakeEntry(&e, (unsigned int)(pst->nRandom >> 33) % N_KEYS);
+
+        if ((l = CacheLookupWithLocking(pst->pc, &e, arOut, &rCubeful)) != CACHEHIT) {
+            CacheAddWithLocking(pst->pc, &e, l);
+            continue;
+        }
+
+        pst->cHits++;
+        for (j = 0; j < 5 && fabsf(arOut[j] - e.ar[j]) <= pst->rError; j++);
+        if (j < 5 || fabsf(rCubeful - e.ar[5]) > pst->rError)
+            pst->cTorn++;
+    }
+
+    return NULL;
+}
+
+static int
+StressCache(cachelayout layout, unsigned int cThreads, unsigned long cLookups)
+{
+    static const char *aszLayout[] = { "full", "compact" };
+    pthread_t athread[16];
+    stressthread ast[16];
+    unsigned long cHits = 0, cTorn = 0;
+    evalCache c;
+    unsigned int i;
+
+    if (CacheCreate(&c, CACHE_SIZE, layout) < 0) {
+        printf("FAIL: cannot create the cache\n");
+        return 1;
+    }
+
+    for (i = 0; i < cThreads; i++) {
+        ast[i].pc = &c;
+        ast[i].rError = layout == CACHE_LAYOUT_COMPACT ? COMPACT_ERROR : 0.0f;
+        ast[i].cLookups = cLookups;
+        ast[i].nRandom = Mix(i + 1);
+        ast[i].cHits = ast[i].cTorn = 0;
+        if (pthread_create(athread + i, NULL, Stress, ast + i)) {
+            printf("FAIL: cannot create thread %u\n", i);
+            exit(1);
+        }
+    }
+
+    for (i = 0; i < cThreads; i++) {
+        pthread_join(athread[i], NULL);
+        cHits += ast[i].cHits;
+        cTorn += ast[i].cTorn;
+    }
+
+    CacheDestroy(&c);
+
+    /* no hits at all would mean nothing was tested */
+    printf("%-7s %2u threads %s: %lu lookups, %lu hits, %lu torn\n", aszLayout[layout], cThreads,
+           cTorn || !cHits ? "FAIL" : "ok", cThreads * cLookups, cHits, cTorn);
+
+    return cTorn || !cHits;
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned long const cLookups = argc > 1 ? strtoul(argv[1], NULL, 10) : 1ul << 20;
+    int fFail = 0;
+
+    fFail |= StressCache(CACHE_LAYOUT_FULL, 8, cLookups);
+    fFail |= StressCache(CACHE_LAYOUT_FULL, 16, cLookups);
+    fFail |= StressCache(CACHE_LAYOUT_COMPACT, 8, cLookups);
+    fFail |= StressCache(CACHE_LAYOUT_COMPACT, 16, cLookups);
+
+    return fFail;
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2025 Alessandro Scotti
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Test that what the evaluation cache returns does not depend on what
+ * was evaluated before, to the last bit:
+ *
+ * - the 0-ply evaluations of the moves of a roll, which the batches of
+ *   ScoreMoves() store, must be those of EvaluatePosition() from an
+ *   empty cache, with the neural net states of the thread
+ * - the moves of a position at 2 plies, cubeful, must score the same
+ *   after the position has been analysed at 1 ply as from an empty
+ *   cache
+ *
+ * The positions are those of random games.  The arguments are their
+ * numbers for each part (default 2000 and 10).
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api.h"
+#include "backgammon.h"
+#include "eval.h"
+#include "multithread.h"
+#include "positionid.h"
+
+static unsigned long cFail;
+
+static unsigned long long nRandom = 0x2545f4914f6cdd1dULL;
+
+static unsigned int
+Random(unsigned int n)
+{
+    nRandom = nRandom * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned int)(nRandom >> 33) % n;
+}
+
+static void
+Report(const TanBoard anBoard, int n0, int n1, const char *sz)
+{
+    if (cFail++ < 10)
+        printf("  %s %d%d: %s\n", PositionID(anBoard), n0, n1, sz);
+}
+
+/* The positions of random games, from the side on roll, and its roll */
+static void
+RandomGames(TanBoard anBoard[], int anDice[][2], unsigned int cPositions)
+{
+    unsigned int c = 0;
+
+    while (c < cPositions) {
+        TanBoard an = {
+            {0, 0, 0, 0, 0, 5, 0, 3, 0, 0, 0, 0, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0},
+            {0, 0, 0, 0, 0, 5, 0, 3, 0, 0, 0, 0, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0}
+        };
+
+        while (c < cPositions && ClassifyPosition((ConstTanBoard)an, VARIATION_STANDARD) != CLASS_OVER) {
+            movelist ml;
+
+            memcpy(anBoard[c], an, sizeof(TanBoard));
+            anDice[c][0] = (int)Random(6) + 1;
+            anDice[c][1] = (int)Random(6) + 1;
+
+            if (GenerateMoves(&ml, (ConstTanBoard)an, anDice[c][0], anDice[c][1], FALSE))
+                PositionFromKey(an, &ml.amMoves[Random(ml.cMoves)].key);
+            SwapSides(an);
+            c++;
+        }
+    }
+}
+
+static void
+CheckBatch(TanBoard anBoard[], int anDice[][2], unsigned int cPositions)
+{
+    evalcontext ec = { FALSE, 0, FALSE, TRUE, FALSE, 0.0f };
+    cubeinfo ci, ciOpp;
+    unsigned int i, j;
+
+    SetCubeInfoMoney(&ci, 1, -1, 0, TRUE, FALSE, VARIATION_STANDARD);
+    SetCubeInfoMoney(&ciOpp, 1, -1, 1, TRUE, FALSE, VARIATION_STANDARD);
+
+    for (i = 0; i < cPositions; i++) {
+        movelist ml;
+        float(*aarBatch)[NUM_OUTPUTS];
+
+        EvalCacheFlush();
+        if (FindnSaveBestMoves(&ml, anDice[i][0], anDice[i][1], (ConstTanBoard)anBoard[i], NULL, 0.0f, &ci, &ec,
+                               defaultFilters) < 0) {
+            Report((ConstTanBoard)anBoard[i], anDice[i][0], anDice[i][1], "evaluation failed");
+            continue;
+        }
+
+        /* the cache holds the batch evaluations now... */
+        aarBatch = malloc(ml.cMoves * sizeof(*aarBatch));
+        for (j = 0; j < ml.cMoves; j++) {
+            TanBoard an;
+
+            PositionFromKeySwapped(an, &ml.amMoves[j].key);
+            EvaluatePosition(MT_Get_nnState(), (ConstTanBoard)an, aarBatch[j], &ciOpp, &ec);
+        }
+
+        /* ...and each one again, alone */
+        EvalCacheFlush();
+        for (j = 0; j < ml.cMoves; j++) {
+            TanBoard an;
+            float ar[NUM_OUTPUTS];
+
+            PositionFromKeySwapped(an, &ml.amMoves[j].key);
+            EvaluatePosition(MT_Get_nnState(), (ConstTanBoard)an, ar, &ciOpp, &ec);
+            if (memcmp(ar, aarBatch[j], sizeof(ar))) {
+                Report((ConstTanBoard)anBoard[i], anDice[i][0], anDice[i][1], "batch and single evaluations differ");
+                break;
+            }
+        }
+
+        free(aarBatch);
+        free(ml.amMoves);
+    }
+}
+
+static int
+FindMoves(movelist *pml, const TanBoard anBoard, const int anDice[2], unsigned int nPlies)
+{
+    evalcontext ec = { TRUE, nPlies, TRUE, TRUE, FALSE, 0.0f };
+    cubeinfo ci;
+
+    SetCubeInfoMoney(&ci, 1, -1, 0, TRUE, FALSE, VARIATION_STANDARD);
+
+    return FindnSaveBestMoves(pml, anDice[0], anDice[1], anBoard, NULL, 0.0f, &ci, &ec, defaultFilters);
+}
+
+static void
+CheckHistory(TanBoard anBoard[], int anDice[][2], unsigned int cPositions)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < cPositions; i++) {
+        movelist ml, mlFresh;
+
+        EvalCacheFlush();
+        if (FindMoves(&mlFresh, (ConstTanBoard)anBoard[i], anDice[i], 2) < 0) {
+            Report((ConstTanBoard)anBoard[i], anDice[i][0], anDice[i][1], "evaluation failed");
+            continue;
+        }
+
+        EvalCacheFlush();
+        if (FindMoves(&ml, (ConstTanBoard)anBoard[i], anDice[i], 1) < 0) {
+            Report((ConstTanBoard)anBoard[i], anDice[i][0], anDice[i][1], "evaluation failed");
+            free(mlFresh.amMoves);
+            continue;
+        }
+        free(ml.amMoves);
+        if (FindMoves(&ml, (ConstTanBoard)anBoard[i], anDice[i], 2) < 0) {
+            Report((ConstTanBoard)anBoard[i], anDice[i][0], anDice[i][1], "evaluation failed");
+            free(mlFresh.amMoves);
+            continue;
+        }
+
+        for (j = 0; j < ml.cMoves && j < mlFresh.cMoves; j++)
+            if (!EqualKeys(ml.amMoves[j].key, mlFresh.amMoves[j].key) ||
+                ml.amMoves[j].rScore != mlFresh.amMoves[j].rScore ||
+                ml.amMoves[j].rScore2 != mlFresh.amMoves[j].rScore2)
+                break;
+        if (j < ml.cMoves || j < mlFresh.cMoves)
+            Report((ConstTanBoard)anBoard[i], anDice[i][0], anDice[i][1], "2-ply scores differ after 1 ply");
+
+        free(ml.amMoves);
+        free(mlFresh.amMoves);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned int const cBatch = argc > 1 ? (unsigned int)atoi(argv[1]) : 2000;
+    unsigned int const cHistory = argc > 2 ? (unsigned int)atoi(argv[2]) : 10;
+    unsigned int const cPositions = cBatch > cHistory ? cBatch : cHistory;
+    TanBoard *anBoard = malloc(cPositions * sizeof(*anBoard));
+    int (*anDice)[2] = malloc(cPositions * sizeof(*anDice));
+
+    if (!anBoard || !anDice || init() < 0) {
+        printf("FAIL: cannot start the engine\n");
+        return 1;
+    }
+
+    RandomGames(anBoard, anDice, cPositions);
+
+    CheckBatch(anBoard, anDice, cBatch);
+    CheckHistory(anBoard, anDice, cHistory);
+
+    printf("%s: %u positions at 0 plies, %u at 2 plies, %lu differences\n", cFail ? "FAIL" : "ok", cBatch,
+           cHistory, cFail);
+
+    shutdown();
+    free(anBoard);
+    free(anDice);
+
+    return cFail ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2025 Alessandro Scotti
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Differential test of GenerateMoves() and GenerateMovesVisit() against
+ * the recursive generator of movegen_ref.c.
+ *
+ * The corpus is made of the positions of random games, and of random
+ * positions with chequers on the bar, partly borne off or few on the
+ * board, which games seldom reach.  Each position is generated for the
+ * 21 rolls, with and without partial moves, and the lists must be the
+ * same move by move: key, play, chequers and pips, in the same order.
+ *
+ * The argument is the number of positions of each kind (default 10000).
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backgammon.h"
+#include "eval.h"
+#include "movegen_ref.h"
+#include "multithread.h"
+#include "positionid.h"
+
+static move amRef[MAX_INCOMPLETE_MOVES];
+static unsigned long cFail;
+
+static unsigned long long nRandom = 0x2545f4914f6cdd1dULL;
+
+static unsigned int
+Random(unsigned int n)
+{
+    nRandom = nRandom * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned int)(nRandom >> 33) % n;
+}
+
+static void
+Report(const TanBoard anBoard, int n0, int n1, int fPartial, const char *sz)
+{
+    if (cFail++ < 10)
+        printf("  %s %d%d%s: %s\n", PositionID(anBoard), n0, n1, fPartial ? " partial" : "", sz);
+}
+
+/* anMove[] of both, up to the -1 after cMoves sub-moves if there is one */
+static int
+EqualPlays(const int anMove0[8], const int anMove1[8], unsigned int cMoves)
+{
+    unsigned int const c = cMoves < 4 ? cMoves * 2 + 1 : 8;
+
+    return memcmp(anMove0, anMove1, c * sizeof(int)) == 0;
+}
+
+typedef struct {
+    const movelist *pml;
+    unsigned int i;
+    int fDiffer;
+} visitcheck;
+
+static int
+CheckVisit(const positionkey * pkey, const int anMove[8], void *p)
+{
+    visitcheck *pvc = p;
+    const move *pm = pvc->pml->amMoves + pvc->i++;
+
+    if (pvc->i > pvc->pml->cMoves || !EqualKeys(*pkey, pm->key) || !EqualPlays(anMove, pm->anMove, pm->cMoves))
+        pvc->fDiffer = TRUE;
+
+    return 0;
+}
+
+static void
+CheckRoll(const TanBoard anBoard, int n0, int n1, int fPartial)
+{
+    movelist mlRef, ml;
+    unsigned int i;
+
+    RefGenerateMoves(&mlRef, amRef, anBoard, n0, n1, fPartial);
+    GenerateMoves(&ml, anBoard, n0, n1, fPartial);
+
+    if (ml.cMoves != mlRef.cMoves || ml.cMaxMoves != mlRef.cMaxMoves || ml.cMaxPips != mlRef.cMaxPips) {
+        Report(anBoard, n0, n1, fPartial, "different number of moves");
+        return;
+    }
+
+    for (i = 0; i < ml.cMoves; i++) {
+        const move *pm = ml.amMoves + i, *pmRef = mlRef.amMoves + i;
+
+        if (!EqualKeys(pm->key, pmRef->key) || pm->cMoves != pmRef->cMoves || pm->cPips != pmRef->cPips ||
+            !EqualPlays(pm->anMove, pmRef->anMove, pmRef->cMoves)) {
+            Report(anBoard, n0, n1, fPartial, "different moves");
+            return;
+        }
+    }
+
+    if (!fPartial) {
+        visitcheck vc = { &mlRef, 0, FALSE };
+
+        if (GenerateMovesVisit(anBoard, n0, n1, CheckVisit, &vc) != (int)mlRef.cMoves || vc.fDiffer)
+            Report(anBoard, n0, n1, fPartial, "different positions visited");
+    }
+}
+
+static void
+CheckRolls(const TanBoard anBoard)
+{
+    int n0, n1, fPartial;
+
+    for (n0 = 1; n0 <= 6; n0++)
+        for (n1 = 1; n1 <= n0; n1++)
+            for (fPartial = 0; fPartial < 2; fPartial++)
+                CheckRoll(anBoard, n0, n1, fPartial);
+}
+
+/* The positions of random games, from the side on roll */
+static unsigned int
+CheckGames(unsigned int cPositions)
+{
+    unsigned int c = 0;
+
+    while (c < cPositions) {
+        TanBoard anBoard = {
+            {0, 0, 0, 0, 0, 5, 0, 3, 0, 0, 0, 0, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0},
+            {0, 0, 0, 0, 0, 5, 0, 3, 0, 0, 0, 0, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0}
+        };
+
+        while (c < cPositions && ClassifyPosition((ConstTanBoard)anBoard, VARIATION_STANDARD) != CLASS_OVER) {
+            movelist ml;
+
+            CheckRolls((ConstTanBoard)anBoard);
+            c++;
+
+            if (GenerateMoves(&ml, (ConstTanBoard)anBoard, Random(6) + 1, Random(6) + 1, FALSE))
+                PositionFromKey(anBoard, &ml.amMoves[Random(ml.cMoves)].key);
+            SwapSides(anBoard);
+        }
+    }
+
+    return c;
+}
+
+/* Up to 15 chequers a side, a third of them in the home board and one
+ * in twelve on the bar */
+static void
+RandomPosition(TanBoard anBoard)
+{
+    int i, j;
+
+    do {
+        memset(anBoard, 0, sizeof(TanBoard));
+
+        for (i = 0; i < 2; i++) {
+            int const c = (int)Random(15) + 1;
+
+            for (j = 0; j < c; j++) {
+                unsigned int const r = Random(12);
+                unsigned int const n = r == 0 ? 24 : r < 5 ? Random(6) : Random(24);
+
+                if (n == 24 || !anBoard[!i][23 - n])
+                    anBoard[i][n]++;
+            }
+        }
+    } while (!CheckPosition((ConstTanBoard)anBoard));
+}
+
+static unsigned int
+CheckRandom(unsigned int cPositions)
+{
+    unsigned int c;
+
+    for (c = 0; c < cPositions; c++) {
+        TanBoard anBoard;
+
+        RandomPosition(anBoard);
+        CheckRolls((ConstTanBoard)anBoard);
+    }
+
+    return c;
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned int const cPositions = argc > 1 ? (unsigned int)atoi(argv[1]) : 10000;
+    unsigned int cGames, cRandom;
+
+    MT_InitThreads();
+
+    cGames = CheckGames(cPositions);
+    cRandom = CheckRandom(cPositions);
+
+    printf("%s: %u game and %u random positions, 21 rolls, with and without partial moves, %lu differences\n",
+           cFail ? "FAIL" : "ok", cGames, cRandom, cFail);
+
+    MT_Close();
+
+    return cFail ? 1 : 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2025 Alessandro Scotti
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Check the Sigmoid() of every kernel against sigmoid() of sigmoid.h:
+ * a sweep of [-12, 12] with a stride in the bit patterns, and every
+ * float within a few ulps of the points where sigmoid() changes segment
+ * (multiples of 0.1) and of the clamp at +-10.  The batches have odd
+ * lengths, so the partial vectors at the end of a call are covered too.
+ *
+ * The test is linked with lib/neuralnetwasm.c compiled against the shim
+ * in tests/wasm, so the simd128 kernel is checked as well.
+ */
+
+#include "config.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "neuralnetsimd.h"
+#include "sigmoid.h"
+
+#define BATCH 1021              /* not a multiple of any vector size */
+#define STRIDE 61               /* bit patterns between two swept floats */
+#define ULPS 8                  /* floats checked each side of a boundary */
+
+static float arIn[BATCH], arOut[BATCH];
+static unsigned int cBatch;
+static unsigned long cChecked;
+static double rMaxError;
+static float xWorst;
+static int fFail;
+
+static void
+Flush(const nnkernel * pnnk)
+{
+    unsigned int i;
+
+    /* Sigmoid() computes sigmoid(-rBeta * x) in place */
+    memcpy(arOut, arIn, cBatch * sizeof(float));
+    pnnk->Sigmoid(arOut, cBatch, -1.0f);
+
+    for (i = 0; i < cBatch; i++) {
+        double const r = fabs((double)arOut[i] - (double)sigmoid(arIn[i]));
+
+        if (!(r <= NN_SIGMOID_MAX_ERROR)) {
+            if (!fFail || r > rMaxError)
+                printf("  %s: sigmoid(%.9g) = %.9g, expected %.9g\n", pnnk->szName, arIn[i], arOut[i],
+                       sigmoid(arIn[i]));
+            fFail = 1;
+        }
+        if (!(r <= rMaxError)) {
+            rMaxError = r;
+            xWorst = arIn[i];
+        }
+    }
+
+    cChecked += cBatch;
+    cBatch = 0;
+}
+
+static void
+Check(const nnkernel * pnnk, float x)
+{
+    arIn[cBatch++] = x;
+    if (cBatch == BATCH)
+        Flush(pnnk);
+}
+
+static float
+FloatFromBits(uint32_t n)
+{
+    float x;
+
+    memcpy(&x, &n, sizeof(x));
+    return x;
+}
+
+static uint32_t
+BitsFromFloat(float x)
+{
+    uint32_t n;
+
+    memcpy(&n, &x, sizeof(n));
+    return n;
+}
+
+/* x and the ULPS floats each side of it */
+static void
+CheckAround(const nnkernel * pnnk, float x)
+{
+    float xDown = x, xUp = x;
+    int i;
+
+    Check(pnnk, x);
+    for (i = 0; i < ULPS; i++) {
+        xDown = nextafterf(xDown, -INFINITY);
+        xUp = nextafterf(xUp, INFINITY);
+        Check(pnnk, xDown);
+        Check(pnnk, xUp);
+    }
+}
+
+static void
+CheckKernel(const nnkernel * pnnk)
+{
+    uint32_t const nMax = BitsFromFloat(12.0f);
+    uint32_t n;
+    int i, fNeg;
+
+    cChecked = 0;
+    rMaxError = 0.0;
+    xWorst = 0.0f;
+    fFail = 0;
+
+    for (fNeg = 0; fNeg < 2; fNeg++) {
+        uint32_t const nSign = fNeg ? 0x80000000u : 0;
+
+        for (n = 0; n <= nMax; n += STRIDE)
+            Check(pnnk, FloatFromBits(n | nSign));
+
+        /* segments of sigmoid() and the clamp at 10 */
+        for (i = 0; i <= 105; i++)
+            CheckAround(pnnk, fNeg ? -i / 10.0f : i / 10.0f);
+
+        Check(pnnk, FloatFromBits(1 | nSign));  /* smallest denormal */
+        Check(pnnk, fNeg ? -FLT_MIN : FLT_MIN);
+        Check(pnnk, fNeg ? -1e6f : 1e6f);
+        Check(pnnk, fNeg ? -FLT_MAX : FLT_MAX);
+        Check(pnnk, fNeg ? -INFINITY : INFINITY);
+    }
+
+    if (cBatch)
+        Flush(pnnk);
+
+    printf("%-14s %s: %lu inputs, max error %.3g at %.9g (limit %.3g)\n", pnnk->szName, fFail ? "FAIL" : "ok",
+           cChecked, rMaxError, xWorst, (double)NN_SIGMOID_MAX_ERROR);
+}
+
+int
+main(void)
+{
+    const nnkernel *apnnk[NN_MAX_KERNELS];
+    unsigned int i, c = NeuralNetKernels(apnnk);
+    int fAnyFail = 0;
+
+    for (i = 0; i < c; i++) {
+        CheckKernel(apnnk[i]);
+        fAnyFail |= fFail;
+    }
+
+    return fAnyFail ? 1 : 0;
+}
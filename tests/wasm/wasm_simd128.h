@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2025 Alessandro Scotti
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The wasm_simd128.h intrinsics used by lib/neuralnetwasm.c, written in
+ * plain C with GCC vector extensions, so that the tests can run the
+ * simd128 kernel natively.  Each lane is computed as the instruction
+ * does it; only the intrinsics the kernel uses are here.
+ */
+
+#ifndef WASM_SIMD128_SHIM_H
+#define WASM_SIMD128_SHIM_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef int32_t v128_t __attribute__((vector_size(16)));
+typedef float f32x4 __attribute__((vector_size(16)));
+
+static inline f32x4
+AsF32(v128_t v)
+{
+    f32x4 f;
+
+    memcpy(&f, &v, 16);
+    return f;
+}
+
+static inline v128_t
+AsV128(f32x4 f)
+{
+    v128_t v;
+
+    memcpy(&v, &f, 16);
+    return v;
+}
+
+static inline v128_t
+wasm_v128_load(const void *p)
+{
+    v128_t v;
+
+    memcpy(&v, p, 16);
+    return v;
+}
+
+static inline void
+wasm_v128_store(void *p, v128_t v)
+{
+    memcpy(p, &v, 16);
+}
+
+static inline v128_t
+wasm_v128_bitselect(v128_t a, v128_t b, v128_t m)
+{
+    return (a & m) | (b & ~m);
+}
+
+static inline v128_t
+wasm_f32x4_splat(float x)
+{
+    return AsV128((f32x4) {x, x, x, x});
+}
+
+static inline v128_t
+wasm_i32x4_splat(int32_t x)
+{
+    return (v128_t) {x, x, x, x};
+}
+
+static inline v128_t
+wasm_f32x4_add(v128_t a, v128_t b)
+{
+    return AsV128(AsF32(a) + AsF32(b));
+}
+
+static inline v128_t
+wasm_f32x4_sub(v128_t a, v128_t b)
+{
+    return AsV128(AsF32(a) - AsF32(b));
+}
+
+static inline v128_t
+wasm_f32x4_mul(v128_t a, v128_t b)
+{
+    return AsV128(AsF32(a) * AsF32(b));
+}
+
+static inline v128_t
+wasm_f32x4_div(v128_t a, v128_t b)
+{
+    return AsV128(AsF32(a) / AsF32(b));
+}
+
+static inline v128_t
+wasm_f32x4_ge(v128_t a, v128_t b)
+{
+    return (v128_t) (AsF32(a) >= AsF32(b));
+}
+
+static inline v128_t
+wasm_f32x4_lt(v128_t a, v128_t b)
+{
+    return (v128_t) (AsF32(a) < AsF32(b));
+}
+
+/* pmin is b < a ? b : a, unlike fminf() on NaN and signed zeros */
+static inline v128_t
+wasm_f32x4_pmin(v128_t a, v128_t b)
+{
+    f32x4 const x = AsF32(a), y = AsF32(b);
+    f32x4 r;
+    int i;
+
+    for (i = 0; i < 4; i++)
+        r[i] = y[i] < x[i] ? y[i] : x[i];
+    return AsV128(r);
+}
+
+static inline v128_t
+wasm_f32x4_abs(v128_t a)
+{
+    f32x4 const x = AsF32(a);
+
+    return AsV128((f32x4) {fabsf(x[0]), fabsf(x[1]), fabsf(x[2]), fabsf(x[3])});
+}
+
+static inline v128_t
+wasm_f32x4_nearest(v128_t a)
+{
+    f32x4 const x = AsF32(a);
+
+    return AsV128((f32x4) {nearbyintf(x[0]), nearbyintf(x[1]), nearbyintf(x[2]), nearbyintf(x[3])});
+}
+
+static inline v128_t
+wasm_f32x4_trunc(v128_t a)
+{
+    f32x4 const x = AsF32(a);
+
+    return AsV128((f32x4) {truncf(x[0]), truncf(x[1]), truncf(x[2]), truncf(x[3])});
+}
+
+#define wasm_f32x4_extract_lane(v, i) (AsF32(v)[i])
+
+static inline v128_t
+wasm_f32x4_convert_i32x4(v128_t v)
+{
+    return AsV128((f32x4) {(float)v[0], (float)v[1], (float)v[2], (float)v[3]});
+}
+
+/* Saturating, as the instruction; NaN gives 0 */
+static inline int32_t
+TruncSat(float x)
+{
+    if (!(x == x))
+        return 0;
+    if (x >= 2147483648.0f)
+        return INT32_MAX;
+    if (x <= -2147483648.0f)
+        return INT32_MIN;
+    return (int32_t)x;
+}
+
+static inline v128_t
+wasm_i32x4_trunc_sat_f32x4(v128_t v)
+{
+    f32x4 const x = AsF32(v);
+
+    return (v128_t) {TruncSat(x[0]), TruncSat(x[1]), TruncSat(x[2]), TruncSat(x[3])};
+}
+
+static inline v128_t
+wasm_i32x4_add(v128_t a, v128_t b)
+{
+    return a + b;
+}
+
+static inline v128_t
+wasm_i32x4_shl(v128_t a, int n)
+{
+    return a << n;
+}
+
+static inline v128_t
+wasm_i32x4_load16x4(const void *p)
+{
+    int16_t as[4];
+
+    memcpy(as, p, sizeof(as));
+    return (v128_t) {as[0], as[1], as[2], as[3]};
+}
+
+static inline v128_t
+wasm_i16x8_load8x8(const void *p)
+{
+    int8_t ac[8];
+    int16_t as[8];
+    v128_t v;
+    int i;
+
+    memcpy(ac, p, sizeof(ac));
+    for (i = 0; i < 8; i++)
+        as[i] = ac[i];
+    memcpy(&v, as, 16);
+    return v;
+}
+
+static inline v128_t
+wasm_i32x4_extend_low_i16x8(v128_t v)
+{
+    int16_t as[8];
+
+    memcpy(as, &v, 16);
+    return (v128_t) {as[0], as[1], as[2], as[3]};
+}
+
+#endif
@@ -2,25 +2,50 @@
  * Copyright (C) 2025 Alessandro Scotti
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
-import createGnubgCoreModule from './gnubg-core-module.js';
 
-export async function initGnubgCore() {
+// Smallest module using a v128 instruction: only validates if the runtime supports SIMD
+const simdProbe = new Uint8Array([
+    0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11
+]);
+
+function hasWasmSimd() {
+    try {
+        return WebAssembly.validate(simdProbe);
+    } catch (e) {
+        return false;
+    }
+}
+
+export async function initGnubgCore(options = {}) {
     const locateFile = (path) => {
         const base = new URL('./', import.meta.url);
         return new URL(path, base).toString();
     };
 
+    const simd = options.simd ?? hasWasmSimd();
+    const { default: createGnubgCoreModule } = simd
+        ? await import('./gnubg-core-module-simd.js')
+        : await import('./gnubg-core-module.js');
+
     const Module = await createGnubgCoreModule({ locateFile });
 
     const mod_init = Module.cwrap('init', 'number', []);
     const mod_shutdown = Module.cwrap('shutdown', 'number', []);
     const mod_hint = Module.cwrap('hint', 'number', ['string', 'number']);
+    const mod_quantize = Module.cwrap('quantize', 'number', ['number']);
+    const mod_bearoff_plays = Module.cwrap('bearoff_plays', 'number', ['number']);
+    const mod_quantization_error = Module.cwrap('quantization_error', 'number', ['number', 'number']);
+    const mod_cache_size = Module.cwrap('cache_size', 'number', ['number', 'number']);
+    const mod_cache_stats = Module.cwrap('cache_stats', 'number', ['number']);
 
     mod_init();
 
-    const hint = (xgid, depth) => {
+    if (options.quantize) {
+        mod_quantize(options.quantize);
+    }
+
+    const getJson = (ptr) => {
         let res = null;
-        const ptr = mod_hint(xgid, depth);
         try {
             const str = Module.UTF8ToString(ptr);
             res = JSON.parse(str);
@@ -30,12 +55,30 @@ export async function initGnubgCore() {
         return res;
     }
 
+    const hint = (xgid, depth) => getJson(mod_hint(xgid, depth));
+
+    const quantize = (bits) => mod_quantize(bits) === 0;
+
+    const bearoffPlays = (enable) => mod_bearoff_plays(enable ? 1 : 0) === 0;
+
+    const quantizationError = (bits, positions = 10000) => getJson(mod_quantization_error(bits, positions));
+
+    const cacheSize = (size, compact = false) => mod_cache_size(size, compact ? 1 : 0);
+
+    const cacheStats = (reset = false) => getJson(mod_cache_stats(reset ? 1 : 0));
+
     const shutdown = () => {
         mod_shutdown();
     }
 
     return {
         hint,
-        shutdown
+        quantize,
+        bearoffPlays,
+        quantizationError,
+        cacheSize,
+        cacheStats,
+        shutdown,
+        simd
     }
 }